@@ -0,0 +1,66 @@
+// Monotonic clock.
+//
+// The kernel maps a clock page read-only at CLOCKPAGE in every
+// process.  On each tick it records there the TSC and the time
+// since boot; a reader adds the TSC cycles since, scaled by
+// mult.  The kernel makes seq odd while it updates the page,
+// so readers retry if seq was odd or changed under them.
+// This assumes that all CPUs' TSCs run at the same rate and
+// were reset together.
+//
+// The page also tells the system call stubs in usys.S whether
+// they can use sysenter; nosysenter must stay the first word.
+
+#define CLOCK_MONOTONIC 1
+
+#define CLOCKSHIFT 24
+
+struct timespec {
+  uint sec;
+  uint nsec;
+};
+
+struct clockpage {
+  uint nosysenter; // Use int $T_SYSCALL, not sysenter
+  uint seq;
+  uint sec;      // Time since boot at the last tick
+  uint nsec;
+  uint mult;     // Nanoseconds per TSC cycle, times 2^CLOCKSHIFT
+  uint64 tsc;    // TSC at the last tick
+};
+
+// Return cycles in nanoseconds.
+static inline uint64
+clockscale(uint64 cycles, uint mult)
+{
+  return ((uint64)(uint)(cycles >> 32) * mult << (32 - CLOCKSHIFT)) +
+         (((uint64)(uint)cycles * mult) >> CLOCKSHIFT);
+}
+
+static inline void
+clockget(volatile struct clockpage *cp, struct timespec *ts)
+{
+  uint seq, sec, nsec, mult;
+  uint64 tsc, ns;
+
+  do{
+    seq = cp->seq;
+    __sync_synchronize();
+    sec = cp->sec;
+    nsec = cp->nsec;
+    mult = cp->mult;
+    tsc = cp->tsc;
+    __sync_synchronize();
+  }while((seq & 1) || cp->seq != seq);
+
+  tsc = rdtsc() - tsc;
+  if((long long)tsc < 0)  // Another CPU's TSC was ahead.
+    tsc = 0;
+  ns = nsec + clockscale(tsc, mult);
+  while(ns >= 1000000000){
+    ns -= 1000000000;
+    sec++;
+  }
+  ts->sec = sec;
+  ts->nsec = ns;
+}
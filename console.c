@@ -14,6 +14,7 @@
 #include "mmu.h"
 #include "proc.h"
 #include "x86.h"
+#include "fcntl.h"
 
 static void consputc(int);
 
@@ -21,11 +22,11 @@ static int panicked = 0;
 
 static struct {
   struct spinlock lock;
-  int locking;
+  int locking;  // Set up; clear when panicking
 } cons;
 
 static void
-printint(int xx, int base, int sign)
+printint(void (*putc)(int), int xx, int base, int sign)
 {
   static char digits[] = "0123456789abcdef";
   char buf[16];
@@ -46,29 +47,36 @@ printint(int xx, int base, int sign)
     buf[i++] = '-';
 
   while(--i >= 0)
-    consputc(buf[i]);
+    putc(buf[i]);
 }
 //PAGEBREAK: 50
 
 // Print to the console. only understands %d, %x, %p, %s.
+// Once the console is set up, and until a panic, the
+// message goes to the kernel log, and from there to the
+// console on the next timer tick (see klog.c).
 void
 cprintf(char *fmt, ...)
 {
-  int i, c, locking;
+  int i, c, logging;
   uint *argp;
   char *s;
-
-  locking = cons.locking;
-  if(locking)
-    acquire(&cons.lock);
+  void (*putc)(int);
 
   if (fmt == 0)
     panic("null fmt");
 
+  logging = cons.locking;
+  if(logging){
+    klogbegin();
+    putc = klogputc;
+  } else
+    putc = consputc;
+
   argp = (uint*)(void*)(&fmt + 1);
   for(i = 0; (c = fmt[i] & 0xff) != 0; i++){
     if(c != '%'){
-      consputc(c);
+      putc(c);
       continue;
     }
     c = fmt[++i] & 0xff;
@@ -76,31 +84,31 @@ cprintf(char *fmt, ...)
       break;
     switch(c){
     case 'd':
-      printint(*argp++, 10, 1);
+      printint(putc, *argp++, 10, 1);
       break;
     case 'x':
     case 'p':
-      printint(*argp++, 16, 0);
+      printint(putc, *argp++, 16, 0);
       break;
     case 's':
       if((s = (char*)*argp++) == 0)
         s = "(null)";
       for(; *s; s++)
-        consputc(*s);
+        putc(*s);
       break;
     case '%':
-      consputc('%');
+      putc('%');
       break;
     default:
       // Print unknown % sequence to draw attention.
-      consputc('%');
-      consputc(c);
+      putc('%');
+      putc(c);
       break;
     }
   }
 
-  if(locking)
-    release(&cons.lock);
+  if(logging)
+    klogend();
 }
 
 void
@@ -111,6 +119,8 @@ panic(char *s)
 
   cli();
   cons.locking = 0;
+  uartflush();
+  klogflush();
   // use lapiccpunum so that we can call panic from mycpu()
   cprintf("lapicid %d: panic: ", lapicid());
   cprintf(s);
@@ -127,50 +137,100 @@ panic(char *s)
 #define BACKSPACE 0x100
 #define CRTPORT 0x3d4
 static ushort *crt = (ushort*)P2V(0xb8000);  // CGA memory
+static int cgapos = -1;  // Cursor position: col + 80*row
 
+// Read cgapos from the CRT controller if it isn't known
+// yet; then, if set, move the hardware cursor to it.
 static void
-cgaputc(int c)
+cgacursor(int set)
 {
-  int pos;
-
-  // Cursor position: col + 80*row.
+  if(cgapos < 0){
+    outb(CRTPORT, 14);
+    cgapos = inb(CRTPORT+1) << 8;
+    outb(CRTPORT, 15);
+    cgapos |= inb(CRTPORT+1);
+  }
+  if(!set)
+    return;
   outb(CRTPORT, 14);
-  pos = inb(CRTPORT+1) << 8;
+  outb(CRTPORT+1, cgapos>>8);
   outb(CRTPORT, 15);
-  pos |= inb(CRTPORT+1);
+  outb(CRTPORT+1, cgapos);
+  crt[cgapos] = ' ' | 0x0700;
+}
 
+// Position after putting c at pos.
+static int
+cganext(int pos, int c)
+{
   if(c == '\n')
-    pos += 80 - pos%80;
-  else if(c == BACKSPACE){
-    if(pos > 0) --pos;
-  } else
-    crt[pos++] = (c&0xff) | 0x0700;  // black on white
+    return pos + 80 - pos%80;
+  return pos + 1;
+}
 
-  if(pos < 0 || pos > 25*80)
-    panic("pos under/overflow");
+// Put n characters on the screen.  Works out first how many
+// rows the screen must scroll, so that it scrolls at most
+// once and the cursor moves only at the end.
+static void
+cgaputs(char *s, int n)
+{
+  int i, pos, rows;
+
+  cgacursor(0);
+  rows = 0;
+  for(pos = cgapos, i = 0; i < n; i++){
+    pos = cganext(pos, s[i] & 0xff);
+    if(pos/80 - 23 > rows)
+      rows = pos/80 - 23;
+  }
 
-  if((pos/80) >= 24){  // Scroll up.
-    memmove(crt, crt+80, sizeof(crt[0])*23*80);
-    pos -= 80;
-    memset(crt+pos, 0, sizeof(crt[0])*(24*80 - pos));
+  if(rows >= 24)
+    memset(crt, 0, sizeof(crt[0])*24*80);
+  else if(rows > 0){  // Scroll up.
+    memmove(crt, crt+80*rows, sizeof(crt[0])*(24-rows)*80);
+    memset(crt+(24-rows)*80, 0, sizeof(crt[0])*rows*80);
   }
 
-  outb(CRTPORT, 14);
-  outb(CRTPORT+1, pos>>8);
-  outb(CRTPORT, 15);
-  outb(CRTPORT+1, pos);
-  crt[pos] = ' ' | 0x0700;
+  // Characters before 80*rows have scrolled off.
+  for(pos = cgapos, i = 0; i < n; i++){
+    if(s[i] != '\n' && pos >= 80*rows)
+      crt[pos - 80*rows] = (s[i]&0xff) | 0x0700;  // black on white
+    pos = cganext(pos, s[i] & 0xff);
+  }
+  cgapos = pos - 80*rows;
+  cgacursor(1);
 }
 
-void
-consputc(int c)
+static void
+cgaputc(int c)
+{
+  char b;
+
+  if(c == BACKSPACE){
+    cgacursor(0);
+    if(cgapos > 0)
+      cgapos--;
+    cgacursor(1);
+    return;
+  }
+  b = c;
+  cgaputs(&b, 1);
+}
+
+static void
+freeze(void)
 {
   if(panicked){
     cli();
     for(;;)
       ;
   }
+}
 
+void
+consputc(int c)
+{
+  freeze();
   if(c == BACKSPACE){
     uartputc('\b'); uartputc(' '); uartputc('\b');
   } else
@@ -178,16 +238,50 @@ consputc(int c)
   cgaputc(c);
 }
 
-#define INPUT_BUF 128
+// Like consputc() for each of the n characters of s.
+static void
+consputs(char *s, int n)
+{
+  int i;
+
+  freeze();
+  for(i = 0; i < n; i++)
+    uartputc(s[i] & 0xff);
+  cgaputs(s, n);
+}
+
+// Write n characters from the kernel log to the console.
+void
+conslog(char *s, int n)
+{
+  int locking;
+
+  locking = cons.locking;
+  if(locking)
+    acquire(&cons.lock);
+  consputs(s, n);
+  if(locking)
+    release(&cons.lock);
+}
+
+#define INPUT_BUF CONSBUF
 struct {
   char buf[INPUT_BUF];
   uint r;  // Read index
   uint w;  // Write index
   uint e;  // Edit index
+  int mode;  // CONS_RAW, CONS_NOECHO
 } input;
 
 #define C(x)  ((x)-'@')  // Control-x
 
+static void
+echo(int c)
+{
+  if(!(input.mode & CONS_NOECHO))
+    consputc(c);
+}
+
 void
 consoleintr(int (*getc)(void))
 {
@@ -195,6 +289,16 @@ consoleintr(int (*getc)(void))
 
   acquire(&cons.lock);
   while((c = getc()) >= 0){
+    if(input.mode & CONS_RAW){
+      // No line editing: each character is ready at once.
+      if(input.e-input.r < INPUT_BUF){
+        input.buf[input.e++ % INPUT_BUF] = c;
+        echo(c);
+        input.w = input.e;
+        wakeup(&input.r);
+      }
+      continue;
+    }
     switch(c){
     case C('P'):  // Process listing.
       // procdump() locks cons.lock indirectly; invoke later
@@ -204,20 +308,20 @@ consoleintr(int (*getc)(void))
       while(input.e != input.w &&
             input.buf[(input.e-1) % INPUT_BUF] != '\n'){
         input.e--;
-        consputc(BACKSPACE);
+        echo(BACKSPACE);
       }
       break;
     case C('H'): case '\x7f':  // Backspace
       if(input.e != input.w){
         input.e--;
-        consputc(BACKSPACE);
+        echo(BACKSPACE);
       }
       break;
     default:
       if(c != 0 && input.e-input.r < INPUT_BUF){
         c = (c == '\r') ? '\n' : c;
         input.buf[input.e++ % INPUT_BUF] = c;
-        consputc(c);
+        echo(c);
         if(c == '\n' || c == C('D') || input.e == input.r+INPUT_BUF){
           input.w = input.e;
           wakeup(&input.r);
@@ -232,11 +336,24 @@ consoleintr(int (*getc)(void))
   }
 }
 
+// Copy n bytes of input from index r to dst.
+static void
+inputcopy(char *dst, uint r, int n)
+{
+  int m;
+
+  m = INPUT_BUF - r % INPUT_BUF;
+  if(m > n)
+    m = n;
+  memmove(dst, input.buf + r % INPUT_BUF, m);
+  memmove(dst + m, input.buf, n - m);
+}
+
 int
-consoleread(struct inode *ip, char *dst, int n)
+consoleread(struct inode *ip, char *dst, uint off, int n)
 {
   uint target;
-  int c;
+  int c, m;
 
   iunlock(ip);
   target = n;
@@ -250,19 +367,34 @@ consoleread(struct inode *ip, char *dst, int n)
       }
       sleep(&input.r, &cons.lock);
     }
-    c = input.buf[input.r++ % INPUT_BUF];
-    if(c == C('D')){  // EOF
-      if(n < target){
-        // Save ^D for next time, to make sure
-        // caller gets a 0-byte result.
-        input.r--;
+
+    // Take what has been typed, up to the end of the
+    // line unless in raw mode, in one copy.
+    for(m = 0; m < n && input.r + m != input.w; m++){
+      c = input.buf[(input.r + m) % INPUT_BUF];
+      if(c == '\n' && !(input.mode & CONS_RAW)){
+        m++;
+        break;
       }
-      break;
+      if(c == C('D') && !(input.mode & CONS_RAW))
+        break;
     }
-    *dst++ = c;
-    --n;
-    if(c == '\n')
+    inputcopy(dst, input.r, m);
+    input.r += m;
+    dst += m;
+    n -= m;
+    if(input.mode & CONS_RAW)
       break;
+    if(m > 0 && dst[-1] == '\n')
+      break;
+    if(n > 0 && input.r != input.w){  // EOF
+      // Consume the ^D only if it is all the caller
+      // gets, so that it sees a 0-byte result; save
+      // it for next time otherwise.
+      if(n == target)
+        input.r++;
+      break;
+    }
   }
   release(&cons.lock);
   ilock(ip);
@@ -270,15 +402,40 @@ consoleread(struct inode *ip, char *dst, int n)
   return target - n;
 }
 
+// CONSGETMODE returns the input mode; CONSSETMODE sets it.
+// Leaving canonical mode hands over the line being edited.
 int
-consolewrite(struct inode *ip, char *buf, int n)
+consoleioctl(struct inode *ip, int req, int arg)
 {
-  int i;
+  int r;
 
+  r = 0;
+  acquire(&cons.lock);
+  switch(req){
+  case CONSGETMODE:
+    r = input.mode;
+    break;
+  case CONSSETMODE:
+    input.mode = arg & (CONS_RAW|CONS_NOECHO);
+    if(input.mode & CONS_RAW){
+      input.w = input.e;
+      wakeup(&input.r);
+    }
+    break;
+  default:
+    r = -1;
+  }
+  release(&cons.lock);
+  return r;
+}
+
+int
+consolewrite(struct inode *ip, char *buf, int n)
+{
   iunlock(ip);
+  uartwait(n);
   acquire(&cons.lock);
-  for(i = 0; i < n; i++)
-    consputc(buf[i] & 0xff);
+  consputs(buf, n);
   release(&cons.lock);
   ilock(ip);
 
@@ -292,8 +449,9 @@ consoleinit(void)
 
   devsw[CONSOLE].write = consolewrite;
   devsw[CONSOLE].read = consoleread;
+  devsw[CONSOLE].ioctl = consoleioctl;
   cons.locking = 1;
 
-  ioapicenable(IRQ_KBD, 0);
+  ioapicenable(IRQ_KBD, ~0);
 }
 
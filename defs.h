@@ -2,13 +2,18 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct kmcache;
+struct lockclass;
 struct pipe;
 struct proc;
+struct procinfo;
 struct rtcdate;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct timespec;
+struct trapframe;
 
 // bio.c
 void            binit(void);
@@ -18,6 +23,7 @@ void            bwrite(struct buf*);
 
 // console.c
 void            consoleinit(void);
+void            conslog(char*, int);
 void            cprintf(char*, ...);
 void            consoleintr(int(*)(void));
 void            panic(char*) __attribute__((noreturn));
@@ -26,11 +32,21 @@ void            panic(char*) __attribute__((noreturn));
 int             exec(char*, char**);
 
 // file.c
+int             fdalloc(struct file*);
+void            fdcloseall(struct proc*);
+int             fdcopy(struct proc*, struct proc*);
+void            fdfree(int);
+int             fdsetlimit(int);
 struct file*    filealloc(void);
 void            fileclose(struct file*);
 struct file*    filedup(struct file*);
 void            fileinit(void);
+int             fileioctl(struct file*, int, int);
+int             filepread(struct file*, char*, int n, uint off);
+int             filepwrite(struct file*, char*, int n, uint off);
 int             fileread(struct file*, char*, int n);
+int             fileseek(struct file*, int, int);
+int             filesplice(struct file*, struct file*, int);
 int             filestat(struct file*, struct stat*);
 int             filewrite(struct file*, char*, int n);
 
@@ -40,8 +56,10 @@ int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
+void            icacheinit(void);
 void            iinit(int dev);
 void            ilock(struct inode*);
+void            ilock_shared(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
 void            iunlockput(struct inode*);
@@ -59,9 +77,11 @@ void            ideintr(void);
 void            iderw(struct buf*);
 
 // ioapic.c
-void            ioapicenable(int irq, int cpu);
+int             ioapicaffinity(int irq, uint mask);
+void            ioapicenable(int irq, uint mask);
 extern uchar    ioapicid;
 void            ioapicinit(void);
+void            irqstatinit(void);
 
 // kalloc.c
 char*           kalloc(void);
@@ -72,15 +92,31 @@ void            kinit2(void*, void*);
 // kbd.c
 void            kbdintr(void);
 
+// klog.c
+void            klogbegin(void);
+void            klogdrain(void);
+void            klogend(void);
+void            klogflush(void);
+void            kloginit(void);
+void            klogputc(int);
+
 // lapic.c
 void            cmostime(struct rtcdate *r);
 int             lapicid(void);
 extern volatile uint*    lapic;
 void            lapiceoi(void);
+void            lapicipi(uchar, int);
 void            lapicinit(void);
+int             lapicpcint(int);
 void            lapicstartap(uchar, uint);
 void            microdelay(int);
 
+// lockprof.c
+void            lockacquired(struct lockclass*, int, uint, uint64);
+struct lockclass* lockclassalloc(char*, int);
+void            lockreleased(struct lockclass*, int, uint64);
+void            lockstatinit(void);
+
 // log.c
 void            initlog(int dev);
 void            log_write(struct buf*);
@@ -97,10 +133,16 @@ void            picinit(void);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
+void            pipeinit(void);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, char*, int);
 int             pipewrite(struct pipe*, char*, int);
 
+// prof.c
+void            profinit(void);
+void            profpmi(struct trapframe*);
+void            proftick(struct trapframe*);
+
 //PAGEBREAK: 16
 // proc.c
 int             cpuid(void);
@@ -112,6 +154,8 @@ struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            pinit(void);
 void            procdump(void);
+int             procinfo(struct procinfo*, int);
+int             tracing(struct proc*);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 void            setproc(struct proc*);
@@ -124,6 +168,14 @@ void            yield(void);
 // swtch.S
 void            swtch(struct context**, struct context*);
 
+// slab.c
+void*           kmalloc(uint);
+void            kmallocinit(void);
+void*           kmcachealloc(struct kmcache*);
+void            kmcachefree(struct kmcache*, void*);
+void            kmcacheinit(struct kmcache*, char*, uint);
+void            kmfree(void*);
+
 // spinlock.c
 void            acquire(struct spinlock*);
 void            getcallerpcs(void*, uint*);
@@ -135,9 +187,11 @@ void            popcli(void);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
+void            acquiresleep_shared(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
+void            initsleeplockclass(struct sleeplock*, char*, struct lockclass*);
 
 // string.c
 int             memcmp(const void*, const void*, uint);
@@ -157,18 +211,31 @@ int             fetchstr(uint, char**);
 void            syscall(void);
 
 // timer.c
+extern char     clockpage[];
+int             clocksleep(uint64);
+void            clockread(struct timespec*);
+void            clocktick(void);
 void            timerinit(void);
 
+// trace.c
+void            traceinit(void);
+void            tracelog(int, uint*, int, uint);
+
 // trap.c
 void            idtinit(void);
+extern int      nosysenter;
+void            sysenterinit(void);
 extern uint     ticks;
+void            trapstatinit(void);
 void            tvinit(void);
 extern struct spinlock tickslock;
 
 // uart.c
+void            uartflush(void);
 void            uartinit(void);
 void            uartintr(void);
 void            uartputc(int);
+void            uartwait(int);
 
 // vm.c
 void            seginit(void);
@@ -0,0 +1,25 @@
+// Print the kernel log, each line starting with the
+// timer tick at which it was logged.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+char buf[512];
+
+int
+main(int argc, char *argv[])
+{
+  int fd, n;
+
+  if((fd = open("/dev/klog", 0)) < 0){
+    printf(2, "dmesg: cannot open /dev/klog\n");
+    exit();
+  }
+  while((n = read(fd, buf, sizeof(buf))) > 0)
+    write(1, buf, n);
+  if(n < 0)
+    printf(2, "dmesg: read error\n");
+  close(fd);
+  exit();
+}
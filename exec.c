@@ -26,7 +26,7 @@ exec(char *path, char **argv)
     cprintf("exec: fail\n");
     return -1;
   }
-  ilock(ip);
+  ilock_shared(ip);
   pgdir = 0;
 
   // Check ELF header
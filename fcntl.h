@@ -2,3 +2,19 @@
 #define O_WRONLY  0x001
 #define O_RDWR    0x002
 #define O_CREATE  0x200
+
+// lseek whence
+#define SEEK_SET  0
+#define SEEK_CUR  1
+#define SEEK_END  2
+
+// console ioctl requests and input modes
+#define CONSGETMODE  1
+#define CONSSETMODE  2
+#define CONS_RAW     0x1  // no line editing; read returns what's typed
+#define CONS_NOECHO  0x2  // don't echo input
+
+// prof device ioctl requests
+#define PROFSTART    3  // arg: cycles per sample, or 0 to sample each tick
+#define PROFSTOP     4  // returns samples lost
+#define PROFMINPERIOD 10000  // fewest cycles per sample PROFSTART takes
@@ -5,21 +5,32 @@
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "stat.h"
+#include "mmu.h"
+#include "proc.h"
 #include "fs.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "fcntl.h"
+#include "slab.h"
 
 struct devsw devsw[NDEV];
+
+// Open files come from filecache, up to NFILE of them.
+// ftable.lock protects the count and every f->ref.
 struct {
   struct spinlock lock;
-  struct file file[NFILE];
+  int nfile;
 } ftable;
 
+static struct kmcache filecache;
+
 void
 fileinit(void)
 {
   initlock(&ftable.lock, "ftable");
+  kmcacheinit(&filecache, "file", sizeof(struct file));
 }
 
 // Allocate a file structure.
@@ -29,15 +40,22 @@ filealloc(void)
   struct file *f;
 
   acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
-    }
+  if(ftable.nfile == NFILE){
+    release(&ftable.lock);
+    return 0;
   }
+  ftable.nfile++;
   release(&ftable.lock);
-  return 0;
+
+  if((f = kmcachealloc(&filecache)) == 0){
+    acquire(&ftable.lock);
+    ftable.nfile--;
+    release(&ftable.lock);
+    return 0;
+  }
+  memset(f, 0, sizeof(*f));
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
@@ -66,9 +84,9 @@ fileclose(struct file *f)
     return;
   }
   ff = *f;
-  f->ref = 0;
-  f->type = FD_NONE;
+  ftable.nfile--;
   release(&ftable.lock);
+  kmcachefree(&filecache, f);
 
   if(ff.type == FD_PIPE)
     pipeclose(ff.pipe, ff.writable);
@@ -84,7 +102,7 @@ int
 filestat(struct file *f, struct stat *st)
 {
   if(f->type == FD_INODE){
-    ilock(f->ip);
+    ilock_shared(f->ip);
     stati(f->ip, st);
     iunlock(f->ip);
     return 0;
@@ -92,66 +110,311 @@ filestat(struct file *f, struct stat *st)
   return -1;
 }
 
+// Read from file f at *off, advancing *off.
+// *off is updated under the inode lock, so it can be
+// f->off even if other processes share f.
+static int
+filereadat(struct file *f, char *addr, int n, uint *off, int shared)
+{
+  int r;
+
+  if(shared)
+    ilock_shared(f->ip);
+  else
+    ilock(f->ip);
+  if((r = readi(f->ip, addr, *off, n)) > 0)
+    *off += r;
+  iunlock(f->ip);
+  return r;
+}
+
 // Read from file f.
 int
 fileread(struct file *f, char *addr, int n)
 {
-  int r;
-
   if(f->readable == 0)
     return -1;
   if(f->type == FD_PIPE)
     return piperead(f->pipe, addr, n);
   if(f->type == FD_INODE){
-    ilock(f->ip);
-    if((r = readi(f->ip, addr, f->off, n)) > 0)
-      f->off += r;
-    iunlock(f->ip);
-    return r;
+    // Readers can share the inode, unless they also share
+    // f and so must serialize their updates to f->off.
+    return filereadat(f, addr, n, &f->off, f->ref == 1);
   }
   panic("fileread");
 }
 
+// Read from file f at offset off, leaving f->off alone.
+int
+filepread(struct file *f, char *addr, int n, uint off)
+{
+  if(f->readable == 0 || f->type != FD_INODE)
+    return -1;
+  return filereadat(f, addr, n, &off, 1);
+}
+
 //PAGEBREAK!
+// Write to file f at *off, advancing *off, as filereadat.
+static int
+filewriteat(struct file *f, char *addr, int n, uint *off)
+{
+  int r;
+
+  // write a few blocks at a time to avoid exceeding
+  // the maximum log transaction size, including
+  // i-node, indirect block, allocation blocks,
+  // and 2 blocks of slop for non-aligned writes.
+  // this really belongs lower down, since writei()
+  // might be writing a device like the console.
+  int max = ((LOGSIZE-1-1-2) / 2) * 512;
+  int i = 0;
+  while(i < n){
+    int n1 = n - i;
+    if(n1 > max)
+      n1 = max;
+
+    begin_op();
+    ilock(f->ip);
+    if ((r = writei(f->ip, addr + i, *off, n1)) > 0)
+      *off += r;
+    iunlock(f->ip);
+    end_op();
+
+    if(r < 0)
+      break;
+    if(r != n1)
+      panic("short filewrite");
+    i += r;
+  }
+  return i == n ? n : -1;
+}
+
 // Write to file f.
 int
 filewrite(struct file *f, char *addr, int n)
 {
-  int r;
-
   if(f->writable == 0)
     return -1;
   if(f->type == FD_PIPE)
     return pipewrite(f->pipe, addr, n);
-  if(f->type == FD_INODE){
-    // write a few blocks at a time to avoid exceeding
-    // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
-    // this really belongs lower down, since writei()
-    // might be writing a device like the console.
-    int max = ((LOGSIZE-1-1-2) / 2) * 512;
-    int i = 0;
-    while(i < n){
-      int n1 = n - i;
-      if(n1 > max)
-        n1 = max;
-
-      begin_op();
-      ilock(f->ip);
-      if ((r = writei(f->ip, addr + i, f->off, n1)) > 0)
-        f->off += r;
-      iunlock(f->ip);
-      end_op();
-
-      if(r < 0)
-        break;
-      if(r != n1)
-        panic("short filewrite");
-      i += r;
+  if(f->type == FD_INODE)
+    return filewriteat(f, addr, n, &f->off);
+  panic("filewrite");
+}
+
+// Write to file f at offset off, leaving f->off alone.
+int
+filepwrite(struct file *f, char *addr, int n, uint off)
+{
+  if(f->writable == 0 || f->type != FD_INODE)
+    return -1;
+  return filewriteat(f, addr, n, &off);
+}
+
+// Set the offset of file f to off, relative to whence
+// (SEEK_SET, SEEK_CUR or SEEK_END).  The offset can't be
+// moved past the end of the file, since files can't have
+// holes.  Returns the new offset.
+int
+fileseek(struct file *f, int off, int whence)
+{
+  int base;
+
+  if(f->type != FD_INODE)
+    return -1;
+  ilock(f->ip);
+  if(whence == SEEK_SET)
+    base = 0;
+  else if(whence == SEEK_CUR)
+    base = f->off;
+  else if(whence == SEEK_END)
+    base = f->ip->size;
+  else
+    base = -1;
+  if(base < 0 || base + off < 0 || base + off > f->ip->size){
+    iunlock(f->ip);
+    return -1;
+  }
+  f->off = base + off;
+  iunlock(f->ip);
+  return f->off;
+}
+
+// Move up to n bytes from file fin to file fout, through a
+// kernel page rather than user memory.  Stops early at the
+// end of fin, or once some data has moved and fin would
+// block.  Returns the number of bytes moved.
+int
+filesplice(struct file *fin, struct file *fout, int n)
+{
+  char *buf;
+  int tot, m, r;
+
+  if(fin->readable == 0 || fout->writable == 0 || n < 0)
+    return -1;
+  if((buf = kalloc()) == 0)
+    return -1;
+  tot = r = 0;
+  while(tot < n){
+    m = n - tot;
+    if(m > PGSIZE)
+      m = PGSIZE;
+    if((r = fileread(fin, buf, m)) <= 0)
+      break;
+    if(filewrite(fout, buf, r) != r){
+      r = -1;
+      break;
     }
-    return i == n ? n : -1;
+    tot += r;
+    if(r < m)
+      break;
   }
-  panic("filewrite");
+  kfree(buf);
+  if(r < 0 && tot == 0)
+    return -1;
+  return tot;
+}
+
+// Device-specific request req, with argument arg.
+int
+fileioctl(struct file *f, int req, int arg)
+{
+  struct inode *ip;
+  int r;
+
+  if(f->type != FD_INODE)
+    return -1;
+  ip = f->ip;
+  ilock(ip);
+  if(ip->type != T_DEV || ip->major < 0 || ip->major >= NDEV ||
+     !devsw[ip->major].ioctl)
+    r = -1;
+  else
+    r = devsw[ip->major].ioctl(ip, req, arg);
+  iunlock(ip);
+  return r;
+}
+
+//PAGEBREAK!
+// Per-process file descriptor tables.  p->ofile has p->nofile
+// slots, a multiple of 32, and bit fd%32 of p->fdused[fd/32] is
+// set while slot fd is in use, so that fdalloc() can skip full
+// words when it looks for the lowest free descriptor.  The table
+// starts empty and doubles when full, up to p->fdlimit slots.
+
+// Grow p's table to n slots.
+static int
+fdgrow(struct proc *p, int n)
+{
+  struct file **ofile;
+  uint *fdused;
+
+  if((ofile = kmalloc(n*sizeof(ofile[0]))) == 0)
+    return -1;
+  if((fdused = kmalloc(n/8)) == 0){
+    kmfree(ofile);
+    return -1;
+  }
+  memset(ofile, 0, n*sizeof(ofile[0]));
+  memset(fdused, 0, n/8);
+  if(p->nofile > 0){
+    memmove(ofile, p->ofile, p->nofile*sizeof(ofile[0]));
+    memmove(fdused, p->fdused, p->nofile/8);
+    kmfree(p->ofile);
+    kmfree(p->fdused);
+  }
+  p->ofile = ofile;
+  p->fdused = fdused;
+  p->nofile = n;
+  return 0;
 }
 
+// Allocate the lowest free file descriptor for the given file.
+// Takes over file reference from caller on success.
+int
+fdalloc(struct file *f)
+{
+  struct proc *p = myproc();
+  int i, fd;
+
+  for(i = 0; i < p->nofile/32; i++)
+    if(p->fdused[i] != ~0)
+      break;
+  fd = i*32;
+  if(i < p->nofile/32)
+    while(p->fdused[i] & (1 << (fd%32)))
+      fd++;
+  if(fd >= p->fdlimit)
+    return -1;
+  if(fd == p->nofile && fdgrow(p, p->nofile ? 2*p->nofile : NOFILE) < 0)
+    return -1;
+  p->ofile[fd] = f;
+  p->fdused[fd/32] |= 1 << (fd%32);
+  return fd;
+}
+
+// Release descriptor fd, without closing its file.
+void
+fdfree(int fd)
+{
+  struct proc *p = myproc();
+
+  p->ofile[fd] = 0;
+  p->fdused[fd/32] &= ~(1 << (fd%32));
+}
+
+// Give np, a new process, a copy of p's descriptors.
+int
+fdcopy(struct proc *np, struct proc *p)
+{
+  int fd;
+
+  np->fdlimit = p->fdlimit;
+  if(p->nofile == 0)
+    return 0;
+  if(fdgrow(np, p->nofile) < 0)
+    return -1;
+  for(fd = 0; fd < p->nofile; fd++)
+    if(p->ofile[fd])
+      np->ofile[fd] = filedup(p->ofile[fd]);
+  memmove(np->fdused, p->fdused, p->nofile/8);
+  return 0;
+}
+
+// Close all of p's descriptors and free its table.
+void
+fdcloseall(struct proc *p)
+{
+  int fd;
+
+  for(fd = 0; fd < p->nofile; fd++){
+    if(p->ofile[fd]){
+      fileclose(p->ofile[fd]);
+      p->ofile[fd] = 0;
+    }
+  }
+  if(p->nofile > 0){
+    kmfree(p->ofile);
+    kmfree(p->fdused);
+  }
+  p->ofile = 0;
+  p->fdused = 0;
+  p->nofile = 0;
+}
+
+// Limit the current process to n descriptors.
+// Fails if n is too big or a descriptor n or above is open.
+int
+fdsetlimit(int n)
+{
+  struct proc *p = myproc();
+  int fd;
+
+  if(n < 0 || n > NOFILEMAX)
+    return -1;
+  for(fd = n; fd < p->nofile; fd++)
+    if(p->ofile[fd])
+      return -1;
+  p->fdlimit = n;
+  return 0;
+}
@@ -14,6 +14,9 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *next; // Next in icache hash chain
+  struct inode *lruprev; // On icache LRU list while ref is 0
+  struct inode *lrunext;
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -28,13 +31,14 @@ struct inode {
 // table mapping major device number to
 // device functions
 struct devsw {
-  int (*read)(struct inode*, char*, int);
+  int (*read)(struct inode*, char*, uint, int);
   int (*write)(struct inode*, char*, int);
+  int (*ioctl)(struct inode*, int, int);
 };
 
 extern struct devsw devsw[];
 
-#define CONSOLE 1
+#include "major.h"
 
 //PAGEBREAK!
 // Blank page.
@@ -20,6 +20,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
+#include "slab.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 static void itrunc(struct inode*);
@@ -120,18 +121,18 @@ bfree(int dev, uint b)
 //   is non-zero. ialloc() allocates, and iput() frees if
 //   the reference and link counts have fallen to zero.
 //
-// * Referencing in cache: an entry in the inode cache
-//   is free if ip->ref is zero. Otherwise ip->ref tracks
-//   the number of in-memory pointers to the entry (open
-//   files and current directories). iget() finds or
-//   creates a cache entry and increments its ref; iput()
-//   decrements ref.
+// * Referencing in cache: ip->ref tracks the number of
+//   in-memory pointers to a cache entry (open files and
+//   current directories). iget() finds or creates a cache
+//   entry and increments its ref; iput() decrements ref.
+//   An entry whose ref has fallen to zero stays cached
+//   until iget() needs its memory for another inode.
 //
 // * Valid: the information (type, size, &c) in an inode
 //   cache entry is only correct when ip->valid is 1.
 //   ilock() reads the inode from
-//   the disk and sets ip->valid, while iput() clears
-//   ip->valid if ip->ref has fallen to zero.
+//   the disk and sets ip->valid; a new entry starts
+//   with ip->valid clear.
 //
 // * Locked: file system code may only examine and modify
 //   the information in an inode and its content if it
@@ -156,29 +157,51 @@ bfree(int dev, uint b)
 // multi-step atomic operations.
 //
 // The icache.lock spin-lock defends the allocation of icache
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold icache.lock while using any of those fields.
+// entries, which come from inodecache, up to NINODE of them,
+// the hash chains that iget() searches by dev and inum, and
+// the LRU list of entries with no references, which iget()
+// recycles from when it reaches NINODE or inodecache is out
+// of memory.  Since ip->ref decides when an entry may be
+// recycled, and ip->dev and ip->inum indicate which i-node
+// an entry holds, one must hold icache.lock while using any
+// of those fields.
 //
 // An ip->lock sleep-lock defends all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
+#define NIHASH 64
+#define IHASH(dev, inum) (((dev) + (inum)) % NIHASH)
+
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  int ninode;
+  struct inode *hash[NIHASH];
+
+  // Entries with ref 0, through lruprev/lrunext.
+  // lru.lrunext is most recently used.
+  struct inode lru;
+
+  struct lockclass *lockclass;  // Of every ip->lock
 } icache;
 
+static struct kmcache inodecache;
+
+// Called from main(): userinit() looks up "/"
+// before the first process can call iinit().
 void
-iinit(int dev)
+icacheinit(void)
 {
-  int i = 0;
-  
   initlock(&icache.lock, "icache");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&icache.inode[i].lock, "inode");
-  }
+  kmcacheinit(&inodecache, "inode", sizeof(struct inode));
+  icache.lru.lruprev = &icache.lru;
+  icache.lru.lrunext = &icache.lru;
+  icache.lockclass = lockclassalloc("inode", 1);
+}
 
+void
+iinit(int dev)
+{
   readsb(dev, &sb);
   cprintf("sb: size %d nblocks %d ninodes %d nlog %d logstart %d\
  inodestart %d bmap start %d\n", sb.size, sb.nblocks,
@@ -242,31 +265,43 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip, **pp;
 
   acquire(&icache.lock);
 
   // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
+  for(ip = icache.hash[IHASH(dev, inum)]; ip; ip = ip->next){
+    if(ip->dev == dev && ip->inum == inum){
+      if(ip->ref++ == 0){
+        ip->lruprev->lrunext = ip->lrunext;
+        ip->lrunext->lruprev = ip->lruprev;
+      }
       release(&icache.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode cache entry.
-  if(empty == 0)
+  // Allocate an inode cache entry, or recycle the least
+  // recently used one that has no references.
+  if(icache.ninode < NINODE && (ip = kmcachealloc(&inodecache)) != 0)
+    icache.ninode++;
+  else if((ip = icache.lru.lruprev) != &icache.lru){
+    ip->lruprev->lrunext = &icache.lru;
+    icache.lru.lruprev = ip->lruprev;
+    pp = &icache.hash[IHASH(ip->dev, ip->inum)];
+    while(*pp != ip)
+      pp = &(*pp)->next;
+    *pp = ip->next;
+  } else
     panic("iget: no inodes");
 
-  ip = empty;
+  memset(ip, 0, sizeof(*ip));
+  initsleeplockclass(&ip->lock, "inode", icache.lockclass);
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
-  ip->valid = 0;
+  ip->next = icache.hash[IHASH(dev, inum)];
+  icache.hash[IHASH(dev, inum)] = ip;
   release(&icache.lock);
 
   return ip;
@@ -312,7 +347,25 @@ ilock(struct inode *ip)
   }
 }
 
-// Unlock the given inode.
+// Lock the given inode shared, for reading only: the
+// holder may call readi, dirlookup and stati, but must
+// not modify the inode or its content.
+void
+ilock_shared(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("ilock_shared");
+
+  // Only an exclusive holder may read the inode from disk.
+  // Once valid, it stays valid while we hold a reference.
+  if(ip->valid == 0){
+    ilock(ip);
+    iunlock(ip);
+  }
+  acquiresleep_shared(&ip->lock);
+}
+
+// Unlock the given inode, locked shared or exclusive.
 void
 iunlock(struct inode *ip)
 {
@@ -323,8 +376,8 @@ iunlock(struct inode *ip)
 }
 
 // Drop a reference to an in-memory inode.
-// If that was the last reference, the inode cache entry can
-// be recycled.
+// If that was the last reference, the inode cache entry
+// goes on the LRU list, for iget() to find or recycle.
 // If that was the last reference and the inode has no links
 // to it, free the inode (and its content) on disk.
 // All calls to iput() must be inside a transaction in
@@ -348,7 +401,12 @@ iput(struct inode *ip)
   releasesleep(&ip->lock);
 
   acquire(&icache.lock);
-  ip->ref--;
+  if(--ip->ref == 0){
+    ip->lrunext = icache.lru.lrunext;
+    ip->lruprev = &icache.lru;
+    icache.lru.lrunext->lruprev = ip;
+    icache.lru.lrunext = ip;
+  }
   release(&icache.lock);
 }
 
@@ -449,7 +507,7 @@ stati(struct inode *ip, struct stat *st)
 
 //PAGEBREAK!
 // Read data from inode.
-// Caller must hold ip->lock.
+// Caller must hold ip->lock, possibly shared.
 int
 readi(struct inode *ip, char *dst, uint off, uint n)
 {
@@ -459,7 +517,7 @@ readi(struct inode *ip, char *dst, uint off, uint n)
   if(ip->type == T_DEV){
     if(ip->major < 0 || ip->major >= NDEV || !devsw[ip->major].read)
       return -1;
-    return devsw[ip->major].read(ip, dst, n);
+    return devsw[ip->major].read(ip, dst, off, n);
   }
 
   if(off > ip->size || off + n < off)
@@ -522,6 +580,7 @@ namecmp(const char *s, const char *t)
 
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
+// Caller must hold dp->lock, possibly shared.
 struct inode*
 dirlookup(struct inode *dp, char *name, uint *poff)
 {
@@ -633,7 +692,7 @@ namex(char *path, int nameiparent, char *name)
     ip = idup(myproc()->cwd);
 
   while((path = skipelem(path, name)) != 0){
-    ilock(ip);
+    ilock_shared(ip);
     if(ip->type != T_DIR){
       iunlockput(ip);
       return 0;
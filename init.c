@@ -4,6 +4,7 @@
 #include "stat.h"
 #include "user.h"
 #include "fcntl.h"
+#include "major.h"
 
 char *argv[] = { "sh", 0 };
 
@@ -13,12 +14,21 @@ main(void)
   int pid, wpid;
 
   if(open("console", O_RDWR) < 0){
-    mknod("console", 1, 1);
+    mknod("console", CONSOLE, 1);
     open("console", O_RDWR);
   }
   dup(0);  // stdout
   dup(0);  // stderr
 
+  // Device nodes other than the console.
+  mkdir("/dev");
+  mknod("/dev/lockstat", LOCKSTAT, 0);
+  mknod("/dev/klog", KLOG, 0);
+  mknod("/dev/irqstat", IRQSTAT, 0);
+  mknod("/dev/trapstat", TRAPSTAT, 0);
+  mknod("/dev/trace", TRACE, 0);
+  mknod("/dev/prof", PROF, 0);
+
   for(;;){
     printf(1, "init: starting sh\n");
     pid = fork();
@@ -1,10 +1,28 @@
 // The I/O APIC manages hardware interrupts for an SMP system.
 // http://www.intel.com/design/chipsets/datashts/29056601.pdf
 // See also picirq.c.
+//
+// Each IRQ goes to a set of CPUs, its affinity: a bitmask of
+// indices into cpus[], which lapicinit() makes the CPUs'
+// logical APIC IDs.  An IRQ with more than one CPU in its
+// affinity uses lowest-priority delivery, which lets the
+// APICs pick one of them for each interrupt.
+//
+// The irqstat device (major IRQSTAT) reads out each IRQ's
+// affinity and how often each CPU has taken it, as an array
+// of struct irqstat.
 
 #include "types.h"
 #include "defs.h"
+#include "param.h"
 #include "traps.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "irqstat.h"
 
 #define IOAPIC  0xFEC00000   // Default physical address of IO APIC
 
@@ -21,9 +39,16 @@
 #define INT_LEVEL      0x00008000  // Level-triggered (vs edge-)
 #define INT_ACTIVELOW  0x00002000  // Active low (vs high)
 #define INT_LOGICAL    0x00000800  // Destination is CPU id (vs APIC ID)
+#define INT_LOWEST     0x00000100  // Lowest-priority delivery (vs fixed)
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
 
 volatile struct ioapic *ioapic;
 
+static struct spinlock ioapiclock;  // Register and affinity updates
+static int maxintr;
+static uint affinity[NIRQ];         // 0 if disabled
+
 // IO APIC MMIO structure: write reg, then read or write data.
 struct ioapic {
   uint reg;
@@ -45,13 +70,30 @@ ioapicwrite(int reg, uint data)
   ioapic->data = data;
 }
 
+// Point irq's redirection entry at the CPUs in mask.
+// Caller must hold ioapiclock.
+static void
+route(int irq, uint mask)
+{
+  uint lo;
+
+  lo = INT_LOGICAL | (T_IRQ0 + irq);
+  if(mask & (mask - 1))  // More than one CPU.
+    lo |= INT_LOWEST;
+  ioapicwrite(REG_TABLE+2*irq+1, mask << 24);
+  ioapicwrite(REG_TABLE+2*irq, lo);
+}
+
 void
 ioapicinit(void)
 {
-  int i, id, maxintr;
+  int i, id;
 
+  initlock(&ioapiclock, "ioapic");
   ioapic = (volatile struct ioapic*)IOAPIC;
   maxintr = (ioapicread(REG_VER) >> 16) & 0xFF;
+  if(maxintr >= NIRQ)
+    maxintr = NIRQ - 1;
   id = ioapicread(REG_ID) >> 24;
   if(id != ioapicid)
     cprintf("ioapicinit: id isn't equal to ioapicid; not a MP\n");
@@ -64,12 +106,74 @@ ioapicinit(void)
   }
 }
 
+// Route irq to the CPUs in mask.  Returns the previous
+// affinity, or -1 if irq is not enabled or mask holds no CPU.
+int
+ioapicaffinity(int irq, uint mask)
+{
+  uint old;
+
+  mask &= (1 << ncpu) - 1;
+  if(irq < 0 || irq > maxintr || mask == 0)
+    return -1;
+  acquire(&ioapiclock);
+  if((old = affinity[irq]) == 0){
+    release(&ioapiclock);
+    return -1;
+  }
+  affinity[irq] = mask;
+  route(irq, mask);
+  release(&ioapiclock);
+  return old;
+}
+
+// Mark interrupt edge-triggered, active high,
+// enabled, and routed to the CPUs in mask.
+void
+ioapicenable(int irq, uint mask)
+{
+  mask &= (1 << ncpu) - 1;
+  acquire(&ioapiclock);
+  affinity[irq] = mask;
+  route(irq, mask);
+  release(&ioapiclock);
+}
+
+//PAGEBREAK!
+// Read one struct irqstat for each IRQ that is enabled or
+// has been taken.  Local APIC interrupts (the timer, IPIs)
+// have affinity 0.
+static int
+irqstatread(struct inode *ip, char *dst, uint off, int n)
+{
+  struct irqstat st;
+  int irq, i, tot, m, o;
+
+  tot = 0;
+  i = 0;
+  for(irq = 0; irq < NIRQ && tot < n; irq++){
+    memset(&st, 0, sizeof(st));
+    st.irq = irq;
+    st.affinity = affinity[irq];
+    for(m = 0; m < ncpu; m++)
+      st.count[m] = cpus[m].ntrap[T_IRQ0 + irq];
+    for(m = 0; m < ncpu && st.count[m] == 0; m++)
+      ;
+    if(st.affinity == 0 && m == ncpu)
+      continue;
+    if(off + tot < (i+1)*sizeof(st)){
+      o = (off + tot) % sizeof(st);
+      m = min(n - tot, sizeof(st) - o);
+      memmove(dst + tot, (char*)&st + o, m);
+      tot += m;
+    }
+    i++;
+  }
+  return tot;
+}
+
 void
-ioapicenable(int irq, int cpunum)
+irqstatinit(void)
 {
-  // Mark interrupt edge-triggered, active high,
-  // enabled, and routed to the given cpunum,
-  // which happens to be that cpu's APIC ID.
-  ioapicwrite(REG_TABLE+2*irq, T_IRQ0 + irq);
-  ioapicwrite(REG_TABLE+2*irq+1, cpunum << 24);
+  devsw[IRQSTAT].read = irqstatread;
 }
@@ -0,0 +1,91 @@
+// Show interrupt counts per CPU, or change where an IRQ goes.
+//
+// usage: irq              print each IRQ's count on each CPU
+//                         and its affinity
+//        irq n mask       route IRQ n to the CPUs in mask,
+//                         bit i for CPU i, e.g. 0x3
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "param.h"
+#include "irqstat.h"
+
+struct irqstat st[32];
+
+// atoi, but also takes hex with a 0x prefix.
+int
+number(char *s)
+{
+  int n, c;
+
+  if(s[0] != '0' || s[1] != 'x')
+    return atoi(s);
+  n = 0;
+  for(s += 2; *s; s++){
+    c = *s;
+    if(c >= '0' && c <= '9')
+      n = n*16 + c - '0';
+    else if(c >= 'a' && c <= 'f')
+      n = n*16 + c - 'a' + 10;
+    else
+      break;
+  }
+  return n;
+}
+
+void
+print(void)
+{
+  int fd, i, j, n, ncpu;
+
+  if((fd = open("/dev/irqstat", O_RDONLY)) < 0){
+    printf(2, "irq: cannot open /dev/irqstat\n");
+    exit();
+  }
+  n = read(fd, st, sizeof(st)) / sizeof(st[0]);
+  close(fd);
+
+  // CPUs that have taken no interrupt at all aren't running.
+  ncpu = 1;
+  for(i = 0; i < n; i++)
+    for(j = ncpu; j < NCPU; j++)
+      if(st[i].count[j])
+        ncpu = j + 1;
+
+  printf(1, "irq");
+  for(j = 0; j < ncpu; j++)
+    printf(1, " cpu%d", j);
+  printf(1, " affinity\n");
+  for(i = 0; i < n; i++){
+    printf(1, "%d", st[i].irq);
+    for(j = 0; j < ncpu; j++)
+      printf(1, " %d", st[i].count[j]);
+    if(st[i].affinity)
+      printf(1, " %x\n", st[i].affinity);
+    else
+      printf(1, " local\n");
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int old;
+
+  if(argc == 1){
+    print();
+    exit();
+  }
+  if(argc != 3){
+    printf(2, "usage: irq [n mask]\n");
+    exit();
+  }
+  if((old = irqaffinity(atoi(argv[1]), number(argv[2]))) < 0){
+    printf(2, "irq: cannot route irq %s to %s\n", argv[1], argv[2]);
+    exit();
+  }
+  printf(1, "irq %s: affinity %x -> %x\n", argv[1], old, number(argv[2]));
+  exit();
+}
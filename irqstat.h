@@ -0,0 +1,7 @@
+// Interrupt statistics, as read from the irqstat device: one
+// record for each IRQ that is enabled or has been taken.
+struct irqstat {
+  int irq;
+  uint affinity;      // CPUs it may go to, bit i for cpus[i]; 0 if local
+  uint count[NCPU];   // Times taken, per CPU
+};
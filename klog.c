@@ -0,0 +1,244 @@
+// Kernel log.
+//
+// Once the console is set up, cprintf() appends each message
+// to a ring buffer of the CPU it runs on, with interrupts off
+// and no lock, so that logging never waits for the console or
+// for other CPUs.  A message becomes visible only when it is
+// complete, as the ring's write index moves past it.  On each
+// timer tick, CPU 0 copies new messages from all the rings to
+// the console, and to the dmesg buffer, where each line starts
+// with the tick at which it was logged.  If a CPU logs faster
+// than that, its ring overruns and its oldest messages are lost.
+//
+// The klog device (major KLOG) reads out the dmesg buffer.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "x86.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+
+#define KLOGBUF  4096   // per-CPU ring size
+#define KLOGMSG  512    // longest message; the rest is dropped
+#define DMESGBUF 16384  // dmesg buffer size
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+// Each message in a ring is a header and then the text.
+struct klogmsg {
+  uint ticks;
+  uint len;
+};
+
+struct klogring {
+  char buf[KLOGBUF];
+  uint w;       // End of the last complete message
+  uint r;       // End of the last message drained
+  uint next;    // Where the message being written goes next
+  uint len;     // Length of the message being written
+  int lost;     // Overrun since the last drain
+};
+
+static struct klogring klog[NCPU];
+
+static struct {
+  struct spinlock lock;
+  char buf[DMESGBUF];
+  uint n;       // Bytes ever written
+  int bol;      // Last byte written ended a line
+} dmesg;
+
+// Start a message.  Interrupts stay off until klogend(),
+// so that nothing else on this CPU writes to its ring.
+void
+klogbegin(void)
+{
+  struct klogring *k;
+
+  pushcli();
+  k = &klog[cpuid()];
+  k->next = k->w + sizeof(struct klogmsg);
+  k->len = 0;
+}
+
+void
+klogputc(int c)
+{
+  struct klogring *k = &klog[cpuid()];
+
+  if(k->len == KLOGMSG)
+    return;
+  k->buf[k->next++ % KLOGBUF] = c;
+  k->len++;
+}
+
+// Copy n bytes between src and the ring at offset off.
+static void
+ringcopy(struct klogring *k, uint off, char *p, uint n, int toring)
+{
+  uint i;
+
+  for(i = 0; i < n; i++, off++){
+    if(toring)
+      k->buf[off % KLOGBUF] = p[i];
+    else
+      p[i] = k->buf[off % KLOGBUF];
+  }
+}
+
+void
+klogend(void)
+{
+  struct klogring *k = &klog[cpuid()];
+  struct klogmsg m;
+
+  m.ticks = ticks;
+  m.len = k->len;
+  ringcopy(k, k->w, (char*)&m, sizeof(m), 1);
+  __sync_synchronize();  // Text and header before w.
+  k->w = k->next;
+  popcli();
+}
+
+// Take the oldest undrained message from ring k into m and
+// text.  Returns 0 if there is none.  A message that the
+// writer might have overwritten meanwhile is dropped, along
+// with everything before it.
+static int
+klogtake(struct klogring *k, struct klogmsg *m, char *text)
+{
+  uint w;
+
+  for(;;){
+    w = k->w;
+    __sync_synchronize();  // Read w before the messages.
+    if(k->r == w)
+      return 0;
+    // The writer may write up to a whole message past w.
+    if(w - k->r > KLOGBUF - sizeof(*m) - KLOGMSG){
+      k->r = w;
+      k->lost = 1;
+      continue;
+    }
+    ringcopy(k, k->r, (char*)m, sizeof(*m), 0);
+    if(m->len > KLOGMSG)
+      m->len = 0;  // Overwritten; caught below.
+    ringcopy(k, k->r + sizeof(*m), text, m->len, 0);
+    __sync_synchronize();
+    if(k->w - k->r > KLOGBUF - sizeof(*m) - KLOGMSG){
+      k->r = k->w;
+      k->lost = 1;
+      continue;
+    }
+    k->r += sizeof(*m) + m->len;
+    return 1;
+  }
+}
+
+static void
+dmesgputs(char *s, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++)
+    dmesg.buf[dmesg.n++ % DMESGBUF] = s[i];
+  if(n > 0)
+    dmesg.bol = s[n-1] == '\n';
+}
+
+// Append text, starting each line with "[ticks] ".
+static void
+dmesgput(uint t, char *text, int n)
+{
+  char num[16];
+  int i, j;
+
+  for(i = 0; i < n; i = j){
+    if(dmesg.bol){
+      j = sizeof(num);
+      do{
+        num[--j] = '0' + t % 10;
+      }while((t /= 10) != 0);
+      num[--j] = '[';
+      dmesgputs(num + j, sizeof(num) - j);
+      dmesgputs("] ", 2);
+    }
+    for(j = i; j < n && text[j] != '\n'; j++)
+      ;
+    if(j < n)
+      j++;
+    dmesgputs(text + i, j - i);
+  }
+}
+
+static void
+klogdrain1(int todmesg)
+{
+  static char text[KLOGMSG];
+  static char lost[] = "klog: messages lost\n";
+  struct klogring *k;
+  struct klogmsg m;
+
+  for(k = klog; k < &klog[ncpu]; k++){
+    while(klogtake(k, &m, text)){
+      if(k->lost){
+        k->lost = 0;
+        conslog(lost, sizeof(lost) - 1);
+        if(todmesg)
+          dmesgput(m.ticks, lost, sizeof(lost) - 1);
+      }
+      conslog(text, m.len);
+      if(todmesg)
+        dmesgput(m.ticks, text, m.len);
+    }
+  }
+}
+
+// Copy new messages to the console and the dmesg buffer.
+// Called by CPU 0 on each timer tick.
+void
+klogdrain(void)
+{
+  acquire(&dmesg.lock);
+  klogdrain1(1);
+  release(&dmesg.lock);
+}
+
+// Copy new messages to the console only, without locks.
+// For panic(), which may have interrupted klogdrain().
+void
+klogflush(void)
+{
+  klogdrain1(0);
+}
+
+// Read the dmesg buffer.  Offsets count from the oldest
+// byte still in it.
+static int
+klogread(struct inode *ip, char *dst, uint off, int n)
+{
+  uint start, i;
+
+  acquire(&dmesg.lock);
+  start = dmesg.n > DMESGBUF ? dmesg.n - DMESGBUF : 0;
+  if(off > dmesg.n - start)
+    off = dmesg.n - start;
+  n = min(n, dmesg.n - start - off);
+  for(i = 0; i < n; i++)
+    dst[i] = dmesg.buf[(start + off + i) % DMESGBUF];
+  release(&dmesg.lock);
+  return n;
+}
+
+void
+kloginit(void)
+{
+  initlock(&dmesg.lock, "dmesg");
+  dmesg.bol = 1;
+  devsw[KLOG].read = klogread;
+}
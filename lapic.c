@@ -9,12 +9,16 @@
 #include "traps.h"
 #include "mmu.h"
 #include "x86.h"
+#include "proc.h"
 
 // Local APIC registers, divided by 4 for use as uint[] indices.
 #define ID      (0x0020/4)   // ID
 #define VER     (0x0030/4)   // Version
 #define TPR     (0x0080/4)   // Task Priority
 #define EOI     (0x00B0/4)   // EOI
+#define LDR     (0x00D0/4)   // Logical Destination
+#define DFR     (0x00E0/4)   // Destination Format
+  #define FLAT       0xFFFFFFFF   // Flat model: LDR is a bitmask
 #define SVR     (0x00F0/4)   // Spurious Interrupt Vector
   #define ENABLE     0x00000100   // Unit Enable
 #define ESR     (0x0280/4)   // Error Status
@@ -54,12 +58,23 @@ lapicw(int index, int value)
 void
 lapicinit(void)
 {
+  int i;
+
   if(!lapic)
     return;
 
   // Enable local APIC; set spurious interrupt vector.
   lapicw(SVR, ENABLE | (T_IRQ0 + IRQ_SPURIOUS));
 
+  // Make this CPU's logical ID the bit for its index in
+  // cpus[], so that the I/O APIC can route an interrupt
+  // to a set of CPUs (see ioapic.c).  NCPU is at most 8.
+  for(i = 0; i < ncpu; i++)
+    if(cpus[i].apicid == lapicid())
+      break;
+  lapicw(DFR, FLAT);
+  lapicw(LDR, (1 << i) << 24);
+
   // The timer repeatedly counts down at bus frequency
   // from lapic[TICR] and then issues an interrupt.
   // If xv6 cared more about precise timekeeping,
@@ -73,7 +88,8 @@ lapicinit(void)
   lapicw(LINT1, MASKED);
 
   // Disable performance counter overflow interrupts
-  // on machines that provide that interrupt entry.
+  // on machines that provide that interrupt entry,
+  // until the profiler asks for them (see lapicpcint).
   if(((lapic[VER]>>16) & 0xFF) >= 4)
     lapicw(PCINT, MASKED);
 
@@ -113,6 +129,19 @@ lapiceoi(void)
     lapicw(EOI, 0);
 }
 
+// Deliver this CPU's performance counter overflow
+// interrupts as IRQ_PERF, or mask them.  Returns -1
+// if the local APIC has no entry for them.  Delivery
+// masks the entry, so the handler must unmask it.
+int
+lapicpcint(int on)
+{
+  if(!lapic || ((lapic[VER]>>16) & 0xFF) < 4)
+    return -1;
+  lapicw(PCINT, on ? T_IRQ0 + IRQ_PERF : MASKED);
+  return 0;
+}
+
 // Spin for a given number of microseconds.
 // On real hardware would want to tune this dynamically.
 void
@@ -120,6 +149,18 @@ microdelay(int us)
 {
 }
 
+// Send interrupt vector to the CPU with the given APIC ID.
+void
+lapicipi(uchar apicid, int vector)
+{
+  if(!lapic)
+    return;
+  lapicw(ICRHI, apicid<<24);
+  lapicw(ICRLO, FIXED | ASSERT | vector);
+  while(lapic[ICRLO] & DELIVS)
+    ;
+}
+
 #define CMOS_PORT    0x70
 #define CMOS_RETURN  0x71
 
@@ -0,0 +1,181 @@
+// Lock profiling.
+//
+// Every spinlock and sleep lock points at the lockclass
+// for its name, where acquisitions, contended acquisitions
+// and the cycles spent waiting for and holding the lock are
+// counted.  Contended acquisitions are also counted per call
+// site, so that a busy lock like ptable.lock can be traced
+// back to the code that fights over it.  All counters are
+// per-CPU and are only updated with interrupts off.
+//
+// The lockstat device (major LOCKSTAT) reads the classes
+// and call sites out as an array of struct lockstat;
+// writing to it resets the counters.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "x86.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "lockstat.h"
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+struct {
+  uint lock;  // Guards allocation; can't be a spinlock itself.
+  int n;
+  struct lockclass class[NLOCKCLASS];
+} lockclasses;
+
+// Contended acquisitions of one class of lock from one call site.
+struct locksite {
+  struct lockclass *class;
+  uint pc;
+  uint ncontend;
+  uint64 wait;
+};
+
+// Open-addressed hash table of call sites, per CPU.
+struct locksite locksites[NCPU][NLOCKSITE];
+
+// Find the class for locks called name, allocating it if
+// this is the first lock with that name.  Returns 0 if the
+// table is full; such locks go uncounted.
+struct lockclass*
+lockclassalloc(char *name, int sleep)
+{
+  struct lockclass *c;
+
+  while(xchg(&lockclasses.lock, 1) != 0)
+    ;
+  for(c = lockclasses.class; c < &lockclasses.class[lockclasses.n]; c++)
+    if(c->sleep == sleep &&
+       (c->name == name || strncmp(c->name, name, 16) == 0))
+      goto found;
+  if(lockclasses.n == NLOCKCLASS){
+    c = 0;
+    goto found;
+  }
+  c = &lockclasses.class[lockclasses.n++];
+  c->name = name;
+  c->sleep = sleep;
+
+found:
+  xchg(&lockclasses.lock, 0);
+  return c;
+}
+
+// Count an acquisition of a lock of class c by cpu from call
+// site pc, after waiting for wait cycles.
+void
+lockacquired(struct lockclass *c, int cpu, uint pc, uint64 wait)
+{
+  struct locksite *s;
+  int i, h;
+
+  c->cpu[cpu].nacquire++;
+  if(wait == 0)
+    return;
+  c->cpu[cpu].ncontend++;
+  c->cpu[cpu].wait += wait;
+
+  // If the table is full, the site goes uncounted.
+  h = (pc >> 2) % NLOCKSITE;
+  for(i = 0; i < NLOCKSITE; i++){
+    s = &locksites[cpu][(h + i) % NLOCKSITE];
+    if(s->class == 0){
+      s->class = c;
+      s->pc = pc;
+    }
+    if(s->class == c && s->pc == pc){
+      s->ncontend++;
+      s->wait += wait;
+      return;
+    }
+  }
+}
+
+// Count hold cycles of a lock of class c released by cpu.
+void
+lockreleased(struct lockclass *c, int cpu, uint64 hold)
+{
+  c->cpu[cpu].hold += hold;
+}
+
+// Sum the per-CPU counters of class c into ls.
+static void
+lockstatfill(struct lockclass *c, struct lockstat *ls)
+{
+  int i;
+
+  memset(ls, 0, sizeof(*ls));
+  safestrcpy(ls->name, c->name, sizeof(ls->name));
+  ls->sleep = c->sleep;
+  for(i = 0; i < NCPU; i++){
+    ls->nacquire += c->cpu[i].nacquire;
+    ls->ncontend += c->cpu[i].ncontend;
+    ls->wait += c->cpu[i].wait;
+    ls->hold += c->cpu[i].hold;
+  }
+}
+
+static void
+locksitefill(struct locksite *s, struct lockstat *ls)
+{
+  memset(ls, 0, sizeof(*ls));
+  if(s->class == 0)
+    return;
+  safestrcpy(ls->name, s->class->name, sizeof(ls->name));
+  ls->sleep = s->class->sleep;
+  ls->pc = s->pc;
+  ls->ncontend = s->ncontend;
+  ls->wait = s->wait;
+}
+
+// Read n bytes at offset off of the array of struct lockstat:
+// the classes, then NLOCKSITE call sites for each CPU.
+static int
+lockstatread(struct inode *ip, char *dst, uint off, int n)
+{
+  struct lockstat ls;
+  uint i, o, m, tot, nclass;
+
+  nclass = lockclasses.n;
+  tot = 0;
+  for(i = off / sizeof(ls); i < nclass + ncpu*NLOCKSITE && tot < n; i++){
+    if(i < nclass)
+      lockstatfill(&lockclasses.class[i], &ls);
+    else
+      locksitefill(&locksites[0][i - nclass], &ls);
+    o = (off + tot) % sizeof(ls);
+    m = min(n - tot, sizeof(ls) - o);
+    memmove(dst + tot, (char*)&ls + o, m);
+    tot += m;
+  }
+  return tot;
+}
+
+// Any write resets all counters.  Updates racing with the
+// reset may survive it.
+static int
+lockstatwrite(struct inode *ip, char *src, int n)
+{
+  int i;
+
+  for(i = 0; i < lockclasses.n; i++)
+    memset(lockclasses.class[i].cpu, 0, sizeof(lockclasses.class[i].cpu));
+  memset(locksites, 0, sizeof(locksites));
+  return n;
+}
+
+void
+lockstatinit(void)
+{
+  devsw[LOCKSTAT].read = lockstatread;
+  devsw[LOCKSTAT].write = lockstatwrite;
+}
@@ -0,0 +1,126 @@
+// Print lock contention statistics, most contended first.
+//
+// usage: lockstat          print the statistics
+//        lockstat -r       reset them
+//        lockstat cmd ...  reset, run cmd, and print them
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "param.h"
+#include "lockstat.h"
+
+#define NSITESHOW 16
+
+struct lockstat ls[NLOCKCLASS + NCPU*NLOCKSITE];
+struct lockstat site[NCPU*NLOCKSITE];
+
+int
+lockstatopen(int mode)
+{
+  int fd;
+
+  if((fd = open("/dev/lockstat", mode)) < 0){
+    printf(2, "lockstat: cannot open /dev/lockstat\n");
+    exit();
+  }
+  return fd;
+}
+
+void
+reset(void)
+{
+  int fd;
+
+  fd = lockstatopen(O_WRONLY);
+  write(fd, "", 1);
+  close(fd);
+}
+
+// Insertion sort by cycles spent waiting.
+void
+sort(struct lockstat *a, int n)
+{
+  struct lockstat t;
+  int i, j;
+
+  for(i = 1; i < n; i++){
+    t = a[i];
+    for(j = i; j > 0 && a[j-1].wait < t.wait; j--)
+      a[j] = a[j-1];
+    a[j] = t;
+  }
+}
+
+void
+print(void)
+{
+  int fd, i, j, n, nname, nsite;
+
+  fd = lockstatopen(O_RDONLY);
+  n = read(fd, ls, sizeof(ls)) / sizeof(ls[0]);
+  close(fd);
+
+  // Per-name totals stay in ls; call sites are merged
+  // across CPUs into site.
+  nname = nsite = 0;
+  for(i = 0; i < n; i++){
+    if(ls[i].nacquire == 0 && ls[i].ncontend == 0)
+      continue;
+    if(ls[i].pc == 0){
+      ls[nname++] = ls[i];
+      continue;
+    }
+    for(j = 0; j < nsite; j++)
+      if(site[j].pc == ls[i].pc && site[j].sleep == ls[i].sleep &&
+         strcmp(site[j].name, ls[i].name) == 0)
+        break;
+    if(j == nsite)
+      site[nsite++] = ls[i];
+    else {
+      site[j].ncontend += ls[i].ncontend;
+      site[j].wait += ls[i].wait;
+    }
+  }
+  sort(ls, nname);
+  sort(site, nsite);
+
+  printf(1, "name type acquire contend wait-kcycles hold-kcycles\n");
+  for(i = 0; i < nname; i++)
+    printf(1, "%s %s %d %d %d %d\n", ls[i].name, ls[i].sleep ? "sleep" : "spin",
+           ls[i].nacquire, ls[i].ncontend,
+           (uint)(ls[i].wait >> 10), (uint)(ls[i].hold >> 10));
+
+  if(nsite == 0)
+    return;
+  printf(1, "\nname call-site contend wait-kcycles\n");
+  for(i = 0; i < nsite && i < NSITESHOW; i++)
+    printf(1, "%s %x %d %d\n", site[i].name, site[i].pc, site[i].ncontend,
+           (uint)(site[i].wait >> 10));
+}
+
+int
+main(int argc, char *argv[])
+{
+  if(argc < 2){
+    print();
+    exit();
+  }
+  reset();
+  if(strcmp(argv[1], "-r") == 0)
+    exit();
+
+  switch(fork()){
+  case -1:
+    printf(2, "lockstat: fork failed\n");
+    exit();
+  case 0:
+    exec(argv[1], argv+1);
+    printf(2, "lockstat: exec %s failed\n", argv[1]);
+    exit();
+  }
+  wait();
+  print();
+  exit();
+}
@@ -0,0 +1,15 @@
+// Lock contention statistics, as read from the lockstat device.
+// The device holds one record per lock name, with totals: all
+// locks initialized with the same name (e.g., every pipe's lock)
+// share a record.  These are followed by NLOCKSITE records per
+// CPU, each counting the contended acquisitions from one call
+// site; unused ones are all zero.  Writing the device resets it.
+struct lockstat {
+  char name[16];      // Lock name
+  int sleep;          // Sleep lock (vs spin lock)?
+  uint pc;            // Call site, or 0 for a per-name total
+  uint nacquire;      // Acquisitions (totals only)
+  uint ncontend;      // Acquisitions that had to wait
+  uint64 wait;        // Cycles spent waiting to acquire
+  uint64 hold;        // Cycles spent holding (totals only)
+};
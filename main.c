@@ -22,6 +22,7 @@ main(void)
   mpinit();        // detect other processors
   lapicinit();     // interrupt controller
   seginit();       // segment descriptors
+  kmallocinit();   // kernel object allocator
   picinit();       // disable pic
   ioapicinit();    // another interrupt controller
   consoleinit();   // console hardware
@@ -30,6 +31,15 @@ main(void)
   tvinit();        // trap vectors
   binit();         // buffer cache
   fileinit();      // file table
+  icacheinit();    // inode cache
+  pipeinit();      // pipe cache
+  lockstatinit();  // lock statistics device
+  kloginit();      // kernel log device
+  irqstatinit();   // interrupt statistics device
+  trapstatinit();  // trap statistics device
+  traceinit();     // system call trace device
+  profinit();      // profiler device
+  timerinit();     // calibrate the clock
   ideinit();       // disk 
   startothers();   // start other processors
   kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
@@ -53,6 +63,7 @@ mpmain(void)
 {
   cprintf("cpu%d: starting %d\n", cpuid(), cpuid());
   idtinit();       // load idt register
+  sysenterinit();  // fast system call entry
   xchg(&(mycpu()->started), 1); // tell startothers() we're up
   scheduler();     // start running processes
 }
@@ -0,0 +1,9 @@
+// Device major numbers, for the kernel's devsw[] (see file.h)
+// and for init, which makes the device nodes.
+#define CONSOLE 1
+#define LOCKSTAT 2
+#define KLOG 3
+#define IRQSTAT 4
+#define TRAPSTAT 5
+#define TRACE 6
+#define PROF 7
@@ -0,0 +1,89 @@
+// Measure malloc and free.
+//
+// usage: mallocbench
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+
+#define LOGN 12          // 2^LOGN operations per measurement
+#define N (1 << LOGN)
+
+void *p[N];
+
+// Allocate N blocks of size bytes, then free them.
+uint
+fixed(uint size)
+{
+  uint64 t;
+  int i;
+
+  t = rdtsc();
+  for(i = 0; i < N; i++)
+    p[i] = malloc(size);
+  for(i = 0; i < N; i++){
+    free(p[i]);
+    p[i] = 0;  // mixed() frees whatever p[] holds
+  }
+  return (rdtsc() - t) >> (LOGN + 1);
+}
+
+// Allocate and free blocks of pseudo-random sizes up to
+// max bytes, keeping about half of them live.
+uint
+mixed(uint max)
+{
+  uint64 t;
+  uint r;
+  int i, j;
+
+  r = 1;
+  t = rdtsc();
+  for(i = 0; i < N; i++){
+    r = r * 1103515245 + 12345;
+    j = (r >> 8) % (N/2);
+    if(p[j]){
+      free(p[j]);
+      p[j] = 0;
+    } else
+      p[j] = malloc((r >> 16) % max + 1);
+  }
+  for(j = 0; j < N/2; j++){
+    free(p[j]);
+    p[j] = 0;
+  }
+  return (rdtsc() - t) >> LOGN;
+}
+
+// Grow one block a little at a time with realloc.
+uint
+grow(void)
+{
+  uint64 t;
+  char *q;
+  int i;
+
+  t = rdtsc();
+  q = 0;
+  for(i = 1; i <= N; i++)
+    q = realloc(q, i*16);
+  free(q);
+  return (rdtsc() - t) >> LOGN;
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *brk;
+
+  brk = sbrk(0);
+  printf(1, "malloc/free 16: %d cycles/op\n", fixed(16));
+  printf(1, "malloc/free 200: %d cycles/op\n", fixed(200));
+  printf(1, "malloc/free 4000: %d cycles/op\n", fixed(4000));
+  printf(1, "mixed up to 1000: %d cycles/op\n", mixed(1000));
+  printf(1, "mixed up to 20000: %d cycles/op\n", mixed(20000));
+  printf(1, "realloc: %d cycles/op\n", grow());
+  printf(1, "heap grew by %d bytes\n", sbrk(0) - brk);
+  exit();
+}
@@ -39,15 +39,27 @@
 
 #define CR4_PSE         0x00000010      // Page size extension
 
+// cpuid leaf 1 %edx feature flags
+#define CPUID_SEP        0x00000800     // sysenter and sysexit
+
+// Model specific registers
+#define MSR_SYSENTER_CS  0x174          // sysenter code segment
+#define MSR_SYSENTER_ESP 0x175          // sysenter stack pointer
+#define MSR_SYSENTER_EIP 0x176          // sysenter entry point
+#define MSR_PMC0         0x0C1          // performance counter 0
+#define MSR_PERFEVTSEL0  0x186          // event select for counter 0
+#define MSR_PERF_OVF_CTRL 0x390         // clear counter overflow status
+
 // various segment selectors.
 #define SEG_KCODE 1  // kernel code
 #define SEG_KDATA 2  // kernel data+stack
 #define SEG_UCODE 3  // user code
 #define SEG_UDATA 4  // user data+stack
-#define SEG_TSS   5  // this process's task state
+#define SEG_KCPU  5  // kernel per-cpu data
+#define SEG_TSS   6  // this process's task state
 
 // cpu->gdt[NSEGS] holds the above segments.
-#define NSEGS     6
+#define NSEGS     7
 
 //PAGEBREAK!
 #ifndef __ASSEMBLER__
@@ -1,12 +1,19 @@
-#define NPROC        64  // maximum number of processes
+#define NPROC       512  // maximum number of processes
 #define KSTACKSIZE 4096  // size of per-process kernel stack
-#define NCPU          8  // maximum number of CPUs
-#define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NCPU          8  // maximum number of CPUs, at most 8 (see lapicinit)
+#define NOFILE       32  // initial open files per process, a multiple of 32
+#define NOFILEMAX  1024  // max open files per process, NOFILE times a power of 2
+#define NFILE      4096  // open files per system
+#define NINODE     1024  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
+#define CONSBUF    4096  // console input buffer size, a power of 2
+#define NLOCKCLASS   64  // maximum number of lock names with statistics
+#define NLOCKSITE    64  // contended lock call sites tracked per CPU
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
+#define NSYSCALL     64  // system call numbers are below this
+#define NSYSHIST     32  // system call latency buckets, by log2 cycles
+#define MAXIOV       16  // max buffers per readv or writev
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
@@ -7,18 +7,34 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "slab.h"
 
-#define PIPESIZE 512
+// The data is a ring buffer of one page.  Readers and
+// writers copy as much as they can with memmove, and only
+// wake the other side if it is waiting.
+#define PIPESIZE PGSIZE
 
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
+  char *data;     // PIPESIZE bytes
   uint nread;     // number of bytes read
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
+  int rwait;      // a reader is sleeping on nread
+  int wwait;      // a writer is sleeping on nwrite
 };
 
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+static struct kmcache pipecache;
+
+void
+pipeinit(void)
+{
+  kmcacheinit(&pipecache, "pipecache", sizeof(struct pipe));
+}
+
 int
 pipealloc(struct file **f0, struct file **f1)
 {
@@ -28,12 +44,16 @@ pipealloc(struct file **f0, struct file **f1)
   *f0 = *f1 = 0;
   if((*f0 = filealloc()) == 0 || (*f1 = filealloc()) == 0)
     goto bad;
-  if((p = (struct pipe*)kalloc()) == 0)
+  if((p = kmcachealloc(&pipecache)) == 0)
+    goto bad;
+  if((p->data = kalloc()) == 0)
     goto bad;
   p->readopen = 1;
   p->writeopen = 1;
   p->nwrite = 0;
   p->nread = 0;
+  p->rwait = 0;
+  p->wwait = 0;
   initlock(&p->lock, "pipe");
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
@@ -47,8 +67,11 @@ pipealloc(struct file **f0, struct file **f1)
 
 //PAGEBREAK: 20
  bad:
-  if(p)
-    kfree((char*)p);
+  if(p){
+    if(p->data)
+      kfree(p->data);
+    kmcachefree(&pipecache, p);
+  }
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -69,30 +92,56 @@ pipeclose(struct pipe *p, int writable)
   }
   if(p->readopen == 0 && p->writeopen == 0){
     release(&p->lock);
-    kfree((char*)p);
+    kfree(p->data);
+    kmcachefree(&pipecache, p);
   } else
     release(&p->lock);
 }
 
+// Wake readers sleeping on p, if any.
+static void
+wakereaders(struct pipe *p)
+{
+  if(p->rwait){
+    p->rwait = 0;
+    wakeup(&p->nread);
+  }
+}
+
+// Wake writers sleeping on p, if any.
+static void
+wakewriters(struct pipe *p)
+{
+  if(p->wwait){
+    p->wwait = 0;
+    wakeup(&p->nwrite);
+  }
+}
+
 //PAGEBREAK: 40
 int
 pipewrite(struct pipe *p, char *addr, int n)
 {
-  int i;
+  int i, m;
 
   acquire(&p->lock);
-  for(i = 0; i < n; i++){
+  for(i = 0; i < n; i += m){
     while(p->nwrite == p->nread + PIPESIZE){  //DOC: pipewrite-full
       if(p->readopen == 0 || myproc()->killed){
         release(&p->lock);
         return -1;
       }
-      wakeup(&p->nread);
+      wakereaders(p);
+      p->wwait = 1;
       sleep(&p->nwrite, &p->lock);  //DOC: pipewrite-sleep
     }
-    p->data[p->nwrite++ % PIPESIZE] = addr[i];
+    // Copy up to the end of the free space or of the ring.
+    m = min(n - i, PIPESIZE - (p->nwrite - p->nread));
+    m = min(m, PIPESIZE - p->nwrite % PIPESIZE);
+    memmove(p->data + p->nwrite % PIPESIZE, addr + i, m);
+    p->nwrite += m;
   }
-  wakeup(&p->nread);  //DOC: pipewrite-wakeup1
+  wakereaders(p);  //DOC: pipewrite-wakeup1
   release(&p->lock);
   return n;
 }
@@ -100,7 +149,7 @@ pipewrite(struct pipe *p, char *addr, int n)
 int
 piperead(struct pipe *p, char *addr, int n)
 {
-  int i;
+  int i, m;
 
   acquire(&p->lock);
   while(p->nread == p->nwrite && p->writeopen){  //DOC: pipe-empty
@@ -108,14 +157,17 @@ piperead(struct pipe *p, char *addr, int n)
       release(&p->lock);
       return -1;
     }
+    p->rwait = 1;
     sleep(&p->nread, &p->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(p->nread == p->nwrite)
-      break;
-    addr[i] = p->data[p->nread++ % PIPESIZE];
+  for(i = 0; i < n && p->nread != p->nwrite; i += m){  //DOC: piperead-copy
+    // At most two copies: up to the end of the ring, then the rest.
+    m = min(n - i, p->nwrite - p->nread);
+    m = min(m, PIPESIZE - p->nread % PIPESIZE);
+    memmove(addr + i, p->data + p->nread % PIPESIZE, m);
+    p->nread += m;
   }
-  wakeup(&p->nwrite);  //DOC: piperead-wakeup
+  wakewriters(p);  //DOC: piperead-wakeup
   release(&p->lock);
   return i;
 }
@@ -5,13 +5,28 @@
 #include "mmu.h"
 #include "x86.h"
 #include "proc.h"
+#include "traps.h"
 #include "spinlock.h"
+#include "slab.h"
+#include "procinfo.h"
 
+#define NPIDHASH 64
+#define PIDHASH(pid) ((uint)(pid) % NPIDHASH)
+
+// Processes are allocated from procache as needed, up to NPROC
+// of them.  Every allocated process is on the list from head,
+// which the scheduler scans, and in the hash by pid, which
+// kill() uses; each process also lists its own children for
+// wait() and exit().  ptable.lock protects all of these.
 struct {
   struct spinlock lock;
-  struct proc proc[NPROC];
+  int nproc;
+  struct proc *head, *tail;
+  struct proc *hash[NPIDHASH];
 } ptable;
 
+static struct kmcache procache;
+
 static struct proc *initproc;
 
 int nextpid = 1;
@@ -19,11 +34,13 @@ extern void forkret(void);
 extern void trapret(void);
 
 static void wakeup1(void *chan);
+static void wakeidle(void);
 
 void
 pinit(void)
 {
   initlock(&ptable.lock, "ptable");
+  kmcacheinit(&procache, "proc", sizeof(struct proc));
 }
 
 // Must be called with interrupts disabled
@@ -32,42 +49,56 @@ cpuid() {
   return mycpu()-cpus;
 }
 
-// Must be called with interrupts disabled to avoid the caller being rescheduled
-// between reading lapicid and running through the loop.
+// Must be called with interrupts disabled to avoid the caller being
+// rescheduled to another cpu while still using the result.
 struct cpu*
 mycpu(void)
 {
-  int apicid, i;
-  
+  struct cpu *c;
+
   if(readeflags()&FL_IF)
     panic("mycpu called with interrupts enabled\n");
-  
-  apicid = lapicid();
-  // APIC IDs are not guaranteed to be contiguous. Maybe we should have
-  // a reverse map, or reserve a register to store &cpus[i].
-  for (i = 0; i < ncpu; ++i) {
-    if (cpus[i].apicid == apicid)
-      return &cpus[i];
-  }
-  panic("unknown apicid\n");
+  asm volatile("movl %%gs:4, %0" : "=r" (c));  // cpu->self
+  return c;
 }
 
-// Disable interrupts so that we are not rescheduled
-// while reading proc from the cpu structure
+// The load is atomic, and the process is the same
+// on whichever cpu it runs, so interrupts may be on.
 struct proc*
 myproc(void) {
-  struct cpu *c;
   struct proc *p;
-  pushcli();
-  c = mycpu();
-  p = c->proc;
-  popcli();
+
+  asm volatile("movl %%gs:0, %0" : "=r" (p));  // cpu->proc
   return p;
 }
 
+// Remove p from the process list and pid hash and free it.
+// p must not be on its parent's list of children.
+// The ptable lock must be held.
+static void
+freeproc(struct proc *p)
+{
+  struct proc **pp;
+
+  if(p->prev)
+    p->prev->next = p->next;
+  else
+    ptable.head = p->next;
+  if(p->next)
+    p->next->prev = p->prev;
+  else
+    ptable.tail = p->prev;
+  for(pp = &ptable.hash[PIDHASH(p->pid)]; *pp != p; pp = &(*pp)->hnext)
+    ;
+  *pp = p->hnext;
+  ptable.nproc--;
+  p->state = UNUSED;
+  kmcachefree(&procache, p);
+}
+
 //PAGEBREAK: 32
-// Look in the process table for an UNUSED proc.
-// If found, change state to EMBRYO and initialize
+// Allocate a proc, unless there are already NPROC.
+// If successful, change state to EMBRYO and initialize
 // state required to run in the kernel.
 // Otherwise return 0.
 static struct proc*
@@ -76,24 +107,36 @@ allocproc(void)
   struct proc *p;
   char *sp;
 
-  acquire(&ptable.lock);
-
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == UNUSED)
-      goto found;
+  if((p = kmcachealloc(&procache)) == 0)
+    return 0;
+  memset(p, 0, sizeof(*p));
 
-  release(&ptable.lock);
-  return 0;
+  acquire(&ptable.lock);
 
-found:
+  if(ptable.nproc == NPROC){
+    release(&ptable.lock);
+    kmcachefree(&procache, p);
+    return 0;
+  }
+  ptable.nproc++;
   p->state = EMBRYO;
   p->pid = nextpid++;
+  p->prev = ptable.tail;
+  if(ptable.tail)
+    ptable.tail->next = p;
+  else
+    ptable.head = p;
+  ptable.tail = p;
+  p->hnext = ptable.hash[PIDHASH(p->pid)];
+  ptable.hash[PIDHASH(p->pid)] = p;
 
   release(&ptable.lock);
 
   // Allocate kernel stack.
   if((p->kstack = kalloc()) == 0){
-    p->state = UNUSED;
+    acquire(&ptable.lock);
+    freeproc(p);
+    release(&ptable.lock);
     return 0;
   }
   sp = p->kstack + KSTACKSIZE;
@@ -141,6 +184,7 @@ userinit(void)
 
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
+  p->fdlimit = NOFILEMAX;
 
   // this assignment to p->state lets other cores
   // run this process. the acquire forces the above
@@ -180,7 +224,7 @@ growproc(int n)
 int
 fork(void)
 {
-  int i, pid;
+  int pid;
   struct proc *np;
   struct proc *curproc = myproc();
 
@@ -190,11 +234,11 @@ fork(void)
   }
 
   // Copy process state from proc.
-  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
-    kfree(np->kstack);
-    np->kstack = 0;
-    np->state = UNUSED;
-    return -1;
+  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0)
+    goto bad;
+  if(fdcopy(np, curproc) < 0){
+    freevm(np->pgdir);
+    goto bad;
   }
   np->sz = curproc->sz;
   np->parent = curproc;
@@ -203,22 +247,30 @@ fork(void)
   // Clear %eax so that fork returns 0 in the child.
   np->tf->eax = 0;
 
-  for(i = 0; i < NOFILE; i++)
-    if(curproc->ofile[i])
-      np->ofile[i] = filedup(curproc->ofile[i]);
   np->cwd = idup(curproc->cwd);
 
   safestrcpy(np->name, curproc->name, sizeof(curproc->name));
+  np->trace = curproc->trace;
 
   pid = np->pid;
 
   acquire(&ptable.lock);
 
+  np->sibling = curproc->child;
+  curproc->child = np;
   np->state = RUNNABLE;
+  wakeidle();
 
   release(&ptable.lock);
 
   return pid;
+
+bad:
+  kfree(np->kstack);
+  acquire(&ptable.lock);
+  freeproc(np);
+  release(&ptable.lock);
+  return -1;
 }
 
 // Exit the current process.  Does not return.
@@ -229,18 +281,12 @@ exit(void)
 {
   struct proc *curproc = myproc();
   struct proc *p;
-  int fd;
 
   if(curproc == initproc)
     panic("init exiting");
 
   // Close all open files.
-  for(fd = 0; fd < NOFILE; fd++){
-    if(curproc->ofile[fd]){
-      fileclose(curproc->ofile[fd]);
-      curproc->ofile[fd] = 0;
-    }
-  }
+  fdcloseall(curproc);
 
   begin_op();
   iput(curproc->cwd);
@@ -253,12 +299,17 @@ exit(void)
   wakeup1(curproc->parent);
 
   // Pass abandoned children to init.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->parent == curproc){
+  if(curproc->child){
+    for(p = curproc->child; ; p = p->sibling){
       p->parent = initproc;
       if(p->state == ZOMBIE)
         wakeup1(initproc);
+      if(p->sibling == 0)
+        break;
     }
+    p->sibling = initproc->child;
+    initproc->child = curproc->child;
+    curproc->child = 0;
   }
 
   // Jump into the scheduler, never to return.
@@ -272,36 +323,28 @@ exit(void)
 int
 wait(void)
 {
-  struct proc *p;
-  int havekids, pid;
+  struct proc *p, **pp;
+  int pid;
   struct proc *curproc = myproc();
   
   acquire(&ptable.lock);
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
-        continue;
-      havekids = 1;
+    // Scan through children looking for exited ones.
+    for(pp = &curproc->child; (p = *pp) != 0; pp = &p->sibling){
       if(p->state == ZOMBIE){
         // Found one.
+        *pp = p->sibling;
         pid = p->pid;
         kfree(p->kstack);
-        p->kstack = 0;
         freevm(p->pgdir);
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
-        p->state = UNUSED;
+        freeproc(p);
         release(&ptable.lock);
         return pid;
       }
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || curproc->killed){
+    if(curproc->child == 0 || curproc->killed){
       release(&ptable.lock);
       return -1;
     }
@@ -324,17 +367,22 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int ran;
   c->proc = 0;
   
   for(;;){
     // Enable interrupts on this processor.
     sti();
 
-    // Loop over process table looking for process to run.
+    // Loop over process list looking for process to run.
+    // A process that runs stays on the list until its parent
+    // holds ptable.lock in wait(), so p->next is safe below.
     acquire(&ptable.lock);
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    ran = 0;
+    for(p = ptable.head; p; p = p->next){
       if(p->state != RUNNABLE)
         continue;
+      ran = 1;
 
       // Switch to chosen process.  It is the process's job
       // to release ptable.lock and then reacquire it
@@ -342,6 +390,7 @@ scheduler(void)
       c->proc = p;
       switchuvm(p);
       p->state = RUNNING;
+      p->cpu = c - cpus;
 
       swtch(&(c->scheduler), p->context);
       switchkvm();
@@ -350,8 +399,22 @@ scheduler(void)
       // It should have changed its p->state before coming back.
       c->proc = 0;
     }
-    release(&ptable.lock);
+    if(ran){
+      release(&ptable.lock);
+      continue;
+    }
 
+    // Nothing to run.  Rather than spin on ptable.lock, halt until
+    // an interrupt arrives: a device, the timer, or the IPI that
+    // wakeidle() sends when it makes a process RUNNABLE.  wakeidle()
+    // clears c->idle before sending, so check it with interrupts
+    // off to avoid sleeping through a wakeup that came in between.
+    c->idle = 1;
+    release(&ptable.lock);
+    cli();
+    if(c->idle)
+      stihlt();
+    c->idle = 0;
   }
 }
 
@@ -387,6 +450,7 @@ yield(void)
 {
   acquire(&ptable.lock);  //DOC: yieldlock
   myproc()->state = RUNNABLE;
+  myproc()->nivcsw++;
   sched();
   release(&ptable.lock);
 }
@@ -438,6 +502,7 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->nvcsw++;
 
   sched();
 
@@ -459,9 +524,28 @@ wakeup1(void *chan)
 {
   struct proc *p;
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan)
+  for(p = ptable.head; p; p = p->next)
+    if(p->state == SLEEPING && p->chan == chan){
       p->state = RUNNABLE;
+      wakeidle();
+    }
+}
+
+// A process has just become RUNNABLE; if some other CPU is
+// halted in scheduler(), send it an IPI so that it runs it.
+// The ptable lock must be held.
+static void
+wakeidle(void)
+{
+  struct cpu *c;
+
+  for(c = cpus; c < cpus+ncpu; c++){
+    if(c->idle && c != mycpu()){
+      c->idle = 0;
+      lapicipi(c->apicid, T_IRQ0 + IRQ_WAKEUP);
+      return;
+    }
+  }
 }
 
 // Wake up all processes sleeping on chan.
@@ -482,12 +566,14 @@ kill(int pid)
   struct proc *p;
 
   acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+  for(p = ptable.hash[PIDHASH(pid)]; p; p = p->hnext){
     if(p->pid == pid){
       p->killed = 1;
       // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
+      if(p->state == SLEEPING){
         p->state = RUNNABLE;
+        wakeidle();
+      }
       release(&ptable.lock);
       return 0;
     }
@@ -496,29 +582,55 @@ kill(int pid)
   return -1;
 }
 
+// Should p's system calls be logged?  p->trace holds the pid
+// of the process that started p's trace session by calling
+// trace(1): p itself or an ancestor.  The session ends when
+// that process stops tracing or exits, and p->trace is then
+// cleared, so that a traced shell's descendants do not log
+// forever.
+int
+tracing(struct proc *p)
+{
+  struct proc *q;
+
+  if(p->trace == 0 || p->trace == p->pid)
+    return p->trace != 0;
+  acquire(&ptable.lock);
+  for(q = ptable.hash[PIDHASH(p->trace)]; q; q = q->hnext)
+    if(q->pid == p->trace)
+      break;
+  if(q == 0 || q->state == ZOMBIE || q->trace != q->pid)
+    p->trace = 0;
+  release(&ptable.lock);
+  return p->trace != 0;
+}
+
 //PAGEBREAK: 36
+static char *states[] = {
+[UNUSED]    "unused",
+[EMBRYO]    "embryo",
+[SLEEPING]  "sleep ",
+[RUNNABLE]  "runble",
+[RUNNING]   "run   ",
+[ZOMBIE]    "zombie"
+};
+
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
-// No lock to avoid wedging a stuck machine further.
+// Procs are slab objects that wait() frees, so the walk
+// needs ptable.lock, unless this CPU already holds it.
 void
 procdump(void)
 {
-  static char *states[] = {
-  [UNUSED]    "unused",
-  [EMBRYO]    "embryo",
-  [SLEEPING]  "sleep ",
-  [RUNNABLE]  "runble",
-  [RUNNING]   "run   ",
-  [ZOMBIE]    "zombie"
-  };
-  int i;
+  int i, locked;
   struct proc *p;
   char *state;
   uint pc[10];
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->state == UNUSED)
-      continue;
+  locked = !holding(&ptable.lock);
+  if(locked)
+    acquire(&ptable.lock);
+  for(p = ptable.head; p; p = p->next){
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
       state = states[p->state];
     else
@@ -531,4 +643,36 @@ procdump(void)
     }
     cprintf("\n");
   }
+  if(locked)
+    release(&ptable.lock);
+}
+
+// Copy up to n processes into pi for getprocinfo().
+// Return how many.
+int
+procinfo(struct procinfo *pi, int n)
+{
+  struct proc *p;
+  int i;
+
+  acquire(&ptable.lock);
+  for(i = 0, p = ptable.head; p && i < n; p = p->next, i++){
+    memset(&pi[i], 0, sizeof(pi[i]));
+    pi[i].pid = p->pid;
+    pi[i].ppid = p->parent ? p->parent->pid : 0;
+    safestrcpy(pi[i].state, states[p->state], sizeof(pi[i].state));
+    safestrcpy(pi[i].name, p->name, sizeof(pi[i].name));
+    pi[i].cpu = p->cpu;
+    pi[i].sz = p->sz;
+    // Every page below sz is resident: there is no demand
+    // paging or sharing.
+    pi[i].rss = PGROUNDUP(p->sz) / PGSIZE;
+    pi[i].utime = p->utime;
+    pi[i].stime = p->stime;
+    pi[i].nvcsw = p->nvcsw;
+    pi[i].nivcsw = p->nivcsw;
+    pi[i].nfault = p->nfault;
+  }
+  release(&ptable.lock);
+  return i;
 }
@@ -1,4 +1,7 @@
-// Per-CPU state
+// Per-CPU state.
+// %gs points at the proc and self fields of the running
+// CPU's struct cpu, so that myproc() and mycpu() can read
+// them with a single instruction; see seginit().
 struct cpu {
   uchar apicid;                // Local APIC ID
   struct context *scheduler;   // swtch() here to enter scheduler
@@ -8,6 +11,12 @@ struct cpu {
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  struct cpu *self;            // This cpu
+  volatile int idle;           // Halted in scheduler() waiting for work?
+  uint ntrap[256];             // Traps other than system calls, by trapno
+  uint nsyscall[NSYSCALL];     // System calls, by number
+  uint64 syscycles[NSYSCALL];  // Cycles spent in them
+  uint syshist[NSYSCALL][NSYSHIST];  // Latency histograms
 };
 
 extern struct cpu cpus[NCPU];
@@ -42,11 +51,23 @@ struct proc {
   enum procstate state;        // Process state
   int pid;                     // Process ID
   struct proc *parent;         // Parent process
+  struct proc *child;          // First child
+  struct proc *sibling;        // Next child of parent
+  struct proc *next, *prev;    // In ptable's list of processes
+  struct proc *hnext;          // Next in ptable's pid hash chain
   struct trapframe *tf;        // Trap frame for current syscall
   struct context *context;     // swtch() here to run process
   void *chan;                  // If non-zero, sleeping on chan
   int killed;                  // If non-zero, have been killed
-  struct file *ofile[NOFILE];  // Open files
+  int trace;                   // Trace session (tracer's pid), or 0
+  int cpu;                     // CPU it last ran on
+  uint utime, stime;           // Ticks in user mode and kernel
+  uint nvcsw, nivcsw;          // Sleeps and preemptions
+  uint nfault;                 // Page faults
+  struct file **ofile;         // Open files, nofile slots
+  uint *fdused;                // Bitmap of ofile slots in use
+  int nofile;                  // Size of ofile
+  int fdlimit;                 // Max open files, see fdlimit()
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
 };
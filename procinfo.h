@@ -0,0 +1,17 @@
+// A process, as returned by getprocinfo().  Times are in
+// timer ticks, charged to whatever was running on the CPU
+// that the tick interrupted.
+struct procinfo {
+  int pid;
+  int ppid;
+  char state[8];
+  char name[16];
+  int cpu;       // CPU it last ran on
+  uint sz;       // Size of process memory (bytes)
+  uint rss;      // Resident pages
+  uint utime;    // Ticks in user mode
+  uint stime;    // Ticks in the kernel
+  uint nvcsw;    // Times it slept
+  uint nivcsw;   // Times it was preempted
+  uint nfault;   // Page faults
+};
@@ -0,0 +1,228 @@
+// Sampling profiler.
+//
+// While the profiler runs, each CPU records a sample of what it
+// was doing each time its timer interrupts it, or, if the
+// profiler was started with a period, each time its first
+// performance counter has counted that many unhalted cycles.
+// A sample is the CPU, the process, the interrupted eip and,
+// in the kernel, the first few return addresses up the %ebp
+// chain.  Code that runs with interrupts off is never sampled.
+// Each CPU records into its own buffer; once that is full,
+// further samples are only counted.
+//
+// The prof device (major PROF) reads out the samples of all
+// CPUs as an array of struct profrec.  The PROFSTART ioctl
+// empties the buffers and starts the profiler; PROFSTOP stops it.
+// Each CPU notices either on its next timer tick.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "x86.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "fcntl.h"
+#include "prof.h"
+
+#define NPROF 1024  // samples kept per CPU
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+// Event select for counter 0: unhalted core cycles in
+// user and kernel mode, interrupting on overflow.
+#define EVT_CYCLES  0x3C
+#define EVT_USR     (1<<16)
+#define EVT_OS      (1<<17)
+#define EVT_INT     (1<<20)
+#define EVT_EN      (1<<22)
+
+struct profbuf {
+  struct spinlock lock;
+  struct profrec rec[NPROF];
+  uint n;       // Samples recorded
+  uint lost;    // Samples that did not fit
+  uint gen;     // prof.gen this CPU has set itself up for
+  int counting; // Counter 0 is armed
+};
+
+static struct profbuf profbuf[NCPU];
+
+static struct {
+  struct spinlock lock;
+  uint gen;     // Bumped on each start and stop
+  int on;
+  int period;   // Cycles per sample; 0 to sample each tick
+  int pmc;      // Architectural performance monitoring version
+} prof;
+
+static void
+record(struct profbuf *b, struct trapframe *tf)
+{
+  struct profrec *r;
+  struct proc *p;
+  uint pcs[10];
+
+  acquire(&b->lock);
+  if(b->n == NPROF){
+    b->lost++;
+    release(&b->lock);
+    return;
+  }
+  r = &b->rec[b->n++];
+  memset(r, 0, sizeof(*r));
+  r->cpu = cpuid();
+  if((p = myproc()) != 0){
+    r->pid = p->pid;
+    safestrcpy(r->name, p->name, sizeof(r->name));
+  }
+  r->eip = tf->eip;
+  if((tf->cs&3) == 0){
+    // getcallerpcs() starts from the frame below its argument.
+    getcallerpcs((uint*)tf->ebp + 2, pcs);
+    memmove(r->pcs, pcs, sizeof(r->pcs));
+  }
+  release(&b->lock);
+}
+
+static void
+disarm(struct profbuf *b)
+{
+  wrmsr(MSR_PERFEVTSEL0, 0);
+  lapicpcint(0);
+  b->counting = 0;
+}
+
+static void
+arm(int period)
+{
+  wrmsr(MSR_PMC0, -period);
+  if(prof.pmc >= 2)
+    wrmsr(MSR_PERF_OVF_CTRL, 1);
+  lapicpcint(1);
+}
+
+// Called on each timer tick.
+void
+proftick(struct trapframe *tf)
+{
+  struct profbuf *b = &profbuf[cpuid()];
+
+  if(b->gen != prof.gen){
+    b->gen = prof.gen;
+    if(b->counting)
+      disarm(b);
+    if(prof.on && prof.period){
+      wrmsr(MSR_PERFEVTSEL0, 0);
+      arm(prof.period);
+      wrmsr(MSR_PERFEVTSEL0, EVT_CYCLES|EVT_USR|EVT_OS|EVT_INT|EVT_EN);
+      b->counting = 1;
+    }
+  }
+  if(prof.on && !prof.period)
+    record(b, tf);
+}
+
+// Called on performance counter overflow.  If the profiler
+// has stopped, disarm now rather than sampling until the
+// next tick.
+void
+profpmi(struct trapframe *tf)
+{
+  struct profbuf *b = &profbuf[cpuid()];
+
+  if(!b->counting)
+    return;
+  if(!prof.on || !prof.period){
+    disarm(b);
+    return;
+  }
+  record(b, tf);
+  arm(prof.period);
+}
+
+// Offsets count across the CPUs' buffers in turn.
+static int
+profread(struct inode *ip, char *dst, uint off, int n)
+{
+  struct profbuf *b;
+  int tot, m, o;
+  uint i;
+
+  tot = 0;
+  i = off / sizeof(struct profrec);
+  for(b = profbuf; b < &profbuf[ncpu] && tot < n; b++){
+    acquire(&b->lock);
+    for(; i < b->n && tot < n; i++){
+      o = (off + tot) % sizeof(struct profrec);
+      m = min(n - tot, sizeof(struct profrec) - o);
+      memmove(dst + tot, (char*)&b->rec[i] + o, m);
+      tot += m;
+    }
+    i -= b->n;
+    release(&b->lock);
+  }
+  return tot;
+}
+
+static int
+profioctl(struct inode *ip, int req, int arg)
+{
+  struct profbuf *b;
+  int lost;
+
+  switch(req){
+  case PROFSTART:
+    // A shorter period would spend most cycles in profpmi.
+    if(arg < 0 || (arg > 0 && (prof.pmc == 0 || arg < PROFMINPERIOD)))
+      return -1;
+    for(b = profbuf; b < &profbuf[ncpu]; b++){
+      acquire(&b->lock);
+      b->n = b->lost = 0;
+      release(&b->lock);
+    }
+    acquire(&prof.lock);
+    prof.period = arg;
+    prof.on = 1;
+    prof.gen++;
+    release(&prof.lock);
+    return 0;
+  case PROFSTOP:
+    acquire(&prof.lock);
+    prof.on = 0;
+    prof.gen++;
+    release(&prof.lock);
+    lost = 0;
+    for(b = profbuf; b < &profbuf[ncpu]; b++)
+      lost += b->lost;
+    return lost;
+  }
+  return -1;
+}
+
+void
+profinit(void)
+{
+  uint r[4];
+  struct profbuf *b;
+
+  initlock(&prof.lock, "prof");
+  for(b = profbuf; b < &profbuf[NCPU]; b++)
+    initlock(&b->lock, "profbuf");
+
+  // Counter 0 can count unhalted cycles if cpuid leaf 0xA
+  // reports a version, at least one counter, and the event.
+  cpuinfo(0, r);
+  if(r[0] >= 0xA){
+    cpuinfo(0xA, r);
+    if((r[0] & 0xFF) && ((r[0]>>8) & 0xFF) && (r[0]>>24) > 0 && !(r[1] & 1)
+       && lapicpcint(0) == 0)
+      prof.pmc = r[0] & 0xFF;
+  }
+
+  devsw[PROF].read = profread;
+  devsw[PROF].ioctl = profioctl;
+}
@@ -0,0 +1,10 @@
+// A profiler sample, as read from the prof device.
+#define NPROFPC 4
+
+struct profrec {
+  int cpu;
+  int pid;              // 0 if no process was running
+  char name[16];        // Process name
+  uint eip;             // Where it was interrupted
+  uint pcs[NPROFPC];    // Callers, for kernel eips
+};
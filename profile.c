@@ -0,0 +1,74 @@
+// Profile the whole system while a command runs.  Prints one
+// line per sample, which profsym.pl on the host turns into a
+// flat profile:
+//
+//   prof cpu pid name eip caller...
+//
+// usage: profile [-c cycles] cmd ...
+//
+// Samples each CPU on each timer tick or, with -c, each time
+// it has run the given number of cycles, at least PROFMINPERIOD.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "prof.h"
+
+struct profrec rec[64];
+
+int
+main(int argc, char *argv[])
+{
+  int fd, i, j, n, period, lost, total;
+  struct profrec *r;
+
+  period = 0;
+  if(argc > 2 && strcmp(argv[1], "-c") == 0){
+    period = atoi(argv[2]);
+    argc -= 2;
+    argv += 2;
+  }
+  if(argc < 2){
+    printf(2, "usage: profile [-c cycles] cmd ...\n");
+    exit();
+  }
+
+  if((fd = open("/dev/prof", O_RDONLY)) < 0){
+    printf(2, "profile: cannot open /dev/prof\n");
+    exit();
+  }
+  if(ioctl(fd, PROFSTART, period) < 0){
+    printf(2, "profile: cannot start profiler\n");
+    exit();
+  }
+  switch(fork()){
+  case -1:
+    printf(2, "profile: fork failed\n");
+    ioctl(fd, PROFSTOP, 0);
+    exit();
+  case 0:
+    close(fd);
+    exec(argv[1], argv+1);
+    printf(2, "profile: exec %s failed\n", argv[1]);
+    exit();
+  }
+  wait();
+  lost = ioctl(fd, PROFSTOP, 0);
+
+  total = 0;
+  while((n = read(fd, rec, sizeof(rec)) / sizeof(rec[0])) > 0){
+    for(i = 0; i < n; i++){
+      r = &rec[i];
+      printf(1, "prof %d %d %s %x", r->cpu, r->pid,
+             r->name[0] ? r->name : "-", r->eip);
+      for(j = 0; j < NPROFPC && r->pcs[j]; j++)
+        printf(1, " %x", r->pcs[j]);
+      printf(1, "\n");
+    }
+    total += n;
+  }
+  printf(2, "profile: %d samples, %d lost\n", total, lost);
+  close(fd);
+  exit();
+}
@@ -0,0 +1,78 @@
+#!/usr/bin/perl -w
+
+# Turn the output of the profile tool into a flat profile.
+#
+# usage: profsym.pl [kernel.sym] < samples
+#
+# Reads "prof cpu pid name eip caller..." lines and ignores
+# the rest, so a whole console log will do.  Kernel addresses
+# are looked up in kernel.sym, and user addresses in name.sym
+# next to it.  For each function, prints the samples taken in
+# it (self) and the samples with it anywhere in the call chain
+# (total).  Chains are only recorded for kernel code, and only
+# a few callers deep.
+
+use strict;
+
+my $ksym = shift || "kernel.sym";
+(my $dir = $ksym) =~ s|[^/]*$||;
+my %syms;     # file => [[addr, name], ...] sorted by addr
+
+sub load {
+    my ($file) = @_;
+    return $syms{$file} if exists $syms{$file};
+    my @s;
+    if(open(my $f, "<", $file)){
+        while(<$f>){
+            my ($addr, $name) = split;
+            next if !defined($name) || $name =~ /\.[cS]$/;
+            push @s, [hex($addr), $name];
+        }
+        close $f;
+    }
+    @s = sort { $a->[0] <=> $b->[0] } @s;
+    return $syms{$file} = \@s;
+}
+
+# Name of the function containing addr.
+sub lookup {
+    my ($addr, $prog) = @_;
+    my $kernel = $addr >= 0x80000000;
+    my $s = load($kernel ? $ksym : "$dir$prog.sym");
+    my ($lo, $hi) = (0, scalar(@$s));
+    while($lo < $hi){
+        my $mid = int(($lo + $hi) / 2);
+        if($s->[$mid][0] <= $addr){
+            $lo = $mid + 1;
+        } else {
+            $hi = $mid;
+        }
+    }
+    return $s->[$lo-1][1] if $lo > 0;
+    return sprintf("%s:%x", $kernel ? "kernel" : $prog, $addr);
+}
+
+my (%self, %total);
+my $n = 0;
+while(<STDIN>){
+    next unless /^prof \d+ \d+ (\S+) ([0-9a-f]+)((?: [0-9a-f]+)*)\s*$/;
+    my ($prog, $eip, @pcs) = ($1, hex($2), map { hex } split(' ', $3));
+    my $f = lookup($eip, $prog);
+    my %seen = ($f => 1);
+    $self{$f}++;
+    $total{$f}++;
+    foreach my $pc (@pcs){
+        my $g = lookup($pc, $prog);
+        $total{$g}++ unless $seen{$g}++;
+    }
+    $n++;
+}
+die "profsym.pl: no samples\n" if $n == 0;
+
+printf("%6s %6s %6s %6s  %s\n", "self", "%", "total", "%", "function");
+$self{$_} ||= 0 foreach keys %total;
+foreach my $f (sort { $self{$b} <=> $self{$a} || $total{$b} <=> $total{$a} }
+               keys %total){
+    printf("%6d %6.1f %6d %6.1f  %s\n", $self{$f}, 100*$self{$f}/$n,
+           $total{$f}, 100*$total{$f}/$n, $f);
+}
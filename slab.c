@@ -0,0 +1,194 @@
+// Slab allocator for kernel objects smaller than a page.
+//
+// A kmcache hands out objects of one size.  It carves them
+// from slabs: pages from kalloc() that start with a struct
+// slab and hold as many objects as fit after it.  Freed
+// objects go first to a small magazine on the freeing cpu,
+// so most allocations and frees take no lock at all; the
+// magazines exchange objects with the slabs in batches.
+// A slab whose objects are all free goes back to kalloc().
+//
+// kmalloc() serves general requests from caches of sizes
+// 16 to 1024 bytes, and anything bigger with a whole page.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "slab.h"
+
+struct slab {
+  struct slab *next;      // On cache's partial list
+  struct kmcache *cache;
+  void *free;             // List of free objects
+  uint inuse;             // Objects allocated or in magazines
+};
+
+#define NKMALLOC 7        // kmalloc caches of 16, 32, ..., 1024 bytes
+
+static struct kmcache kmalloccache[NKMALLOC];
+static char *kmallocname[NKMALLOC] = {
+  "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+  "kmalloc-256", "kmalloc-512", "kmalloc-1024",
+};
+
+// The cache's lock takes its name, so that each cache has
+// its own lock class; name must not be another lock's name.
+void
+kmcacheinit(struct kmcache *c, char *name, uint size)
+{
+  memset(c, 0, sizeof(*c));
+  c->name = name;
+  c->size = (size + 7) & ~7;
+  c->perslab = (PGSIZE - sizeof(struct slab)) / c->size;
+  if(c->perslab == 0)
+    panic("kmcacheinit");
+  initlock(&c->lock, name);
+}
+
+void
+kmallocinit(void)
+{
+  int i;
+
+  for(i = 0; i < NKMALLOC; i++)
+    kmcacheinit(&kmalloccache[i], kmallocname[i], 16 << i);
+}
+
+// Add a new slab to c's partial list.
+// Caller must hold c->lock.
+static int
+slabgrow(struct kmcache *c)
+{
+  struct slab *s;
+  char *o;
+  int i;
+
+  if((s = (struct slab*)kalloc()) == 0)
+    return -1;
+  s->cache = c;
+  s->inuse = 0;
+  s->free = 0;
+  for(i = c->perslab - 1; i >= 0; i--){
+    o = (char*)(s + 1) + i*c->size;
+    *(void**)o = s->free;
+    s->free = o;
+  }
+  s->next = c->partial;
+  c->partial = s;
+  return 0;
+}
+
+// Move up to n objects from c's slabs into m.
+// Caller must hold c->lock.
+static void
+magfill(struct kmcache *c, struct kmmag *m, int n)
+{
+  struct slab *s;
+  void *o;
+
+  while(m->n < n){
+    if(c->partial == 0 && slabgrow(c) < 0)
+      return;
+    s = c->partial;
+    o = s->free;
+    s->free = *(void**)o;
+    s->inuse++;
+    if(s->free == 0)
+      c->partial = s->next;
+    m->obj[m->n++] = o;
+  }
+}
+
+// Return object o to its slab.
+// Caller must hold c->lock.
+static void
+slabput(struct kmcache *c, void *o)
+{
+  struct slab *s, **pp;
+
+  s = (struct slab*)PGROUNDDOWN((uint)o);
+  if(s->free == 0){
+    s->next = c->partial;
+    c->partial = s;
+  }
+  *(void**)o = s->free;
+  s->free = o;
+  if(--s->inuse == 0){
+    for(pp = &c->partial; *pp != s; pp = &(*pp)->next)
+      ;
+    *pp = s->next;
+    kfree((char*)s);
+  }
+}
+
+// Allocate an object from cache c.
+// Returns 0 if the memory cannot be allocated.
+void*
+kmcachealloc(struct kmcache *c)
+{
+  struct kmmag *m;
+  void *o;
+
+  pushcli();
+  m = &c->mag[cpuid()];
+  if(m->n == 0){
+    acquire(&c->lock);
+    magfill(c, m, KMMAG/2);
+    release(&c->lock);
+  }
+  o = 0;
+  if(m->n > 0)
+    o = m->obj[--m->n];
+  popcli();
+  return o;
+}
+
+// Free object o, allocated from cache c.
+void
+kmcachefree(struct kmcache *c, void *o)
+{
+  struct kmmag *m;
+
+  if((uint)o % PGSIZE == 0 || ((struct slab*)PGROUNDDOWN((uint)o))->cache != c)
+    panic("kmcachefree");
+
+  pushcli();
+  m = &c->mag[cpuid()];
+  if(m->n == KMMAG){
+    acquire(&c->lock);
+    while(m->n > KMMAG/2)
+      slabput(c, m->obj[--m->n]);
+    release(&c->lock);
+  }
+  m->obj[m->n++] = o;
+  popcli();
+}
+
+// Allocate n bytes of kernel memory, at most a page.
+// Returns 0 if the memory cannot be allocated.
+void*
+kmalloc(uint n)
+{
+  int i;
+
+  for(i = 0; i < NKMALLOC; i++)
+    if(n <= kmalloccache[i].size)
+      return kmcachealloc(&kmalloccache[i]);
+  if(n <= PGSIZE)
+    return kalloc();
+  return 0;
+}
+
+// Free memory returned by kmalloc().  Whole pages are
+// page-aligned; objects in slabs never are.
+void
+kmfree(void *p)
+{
+  if((uint)p % PGSIZE == 0)
+    kfree(p);
+  else
+    kmcachefree(((struct slab*)PGROUNDDOWN((uint)p))->cache, p);
+}
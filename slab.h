@@ -0,0 +1,18 @@
+// Caches of same-sized kernel objects, see slab.c.
+
+#define KMMAG 16  // objects cached per cpu
+
+// Free objects cached by one cpu, used without locking.
+struct kmmag {
+  int n;
+  void *obj[KMMAG];
+};
+
+struct kmcache {
+  char *name;
+  uint size;             // Object size, a multiple of 8 bytes
+  uint perslab;          // Objects per slab
+  struct spinlock lock;  // Protects partial and the slabs on it
+  struct slab *partial;  // Slabs with free objects
+  struct kmmag mag[NCPU];
+};
@@ -1,4 +1,18 @@
 // Sleeping locks
+//
+// A contended acquiresleep() first spins for a while if the
+// holder is running on another CPU, since it will likely
+// release the lock sooner than a sleep and wakeup would take.
+// Otherwise the process queues itself on the lock and sleeps;
+// releasesleep() wakes only the oldest waiter, instead of
+// every process sleeping on the lock.
+//
+// acquiresleep_shared() lets readers hold the lock together.
+// Readers are let in whenever no one holds the lock
+// exclusively and the oldest waiter is not a writer, so that
+// a stream of readers cannot starve writers.  When the lock
+// becomes free the oldest waiter is woken along with any
+// readers queued right behind it.
 
 #include "types.h"
 #include "defs.h"
@@ -10,34 +24,181 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 
+#define SPINLIMIT 4096  // pause()s to spin before sleeping
+
 void
 initsleeplock(struct sleeplock *lk, char *name)
+{
+  initsleeplockclass(lk, name, lockclassalloc(name, 1));
+}
+
+// Like initsleeplock, with the class already looked up by
+// lockclassalloc(name, 1), for locks set up over and over.
+void
+initsleeplockclass(struct sleeplock *lk, char *name, struct lockclass *class)
 {
   initlock(&lk->lk, "sleep lock");
   lk->name = name;
   lk->locked = 0;
+  lk->readers = 0;
+  lk->head = lk->tail = 0;
+  lk->proc = 0;
   lk->pid = 0;
+  lk->class = class;
 }
 
-void
-acquiresleep(struct sleeplock *lk)
+// Spin while lk is held by a process that is running,
+// which must be on another CPU.  The unlocked reads are
+// only a hint; acquiresleep() checks again under lk->lk.
+static int
+spinsleep(struct sleeplock *lk)
+{
+  volatile struct sleeplock *vlk = lk;
+  struct proc *p;
+  int n;
+
+  for(n = 0; n < SPINLIMIT && vlk->locked; n++){
+    p = vlk->proc;
+    if(p == 0 || p->state != RUNNING)
+      break;
+    pause();
+  }
+  return n > 0;
+}
+
+// Remove w from lk's queue.
+static void
+dequeue(struct sleeplock *lk, struct sleepwaiter *w)
+{
+  struct sleepwaiter **pp, *prev;
+
+  prev = 0;
+  for(pp = &lk->head; *pp != w; pp = &(*pp)->next)
+    prev = *pp;
+  *pp = w->next;
+  if(lk->tail == w)
+    lk->tail = prev;
+  w->queued = 0;
+}
+
+// Must w wait for lk?  woken is set once releasesleep()
+// has dequeued and woken w.
+static int
+mustwait(struct sleeplock *lk, struct sleepwaiter *w, int woken)
+{
+  if(lk->locked)
+    return 1;
+  if(!w->shared)
+    return lk->readers > 0;
+  // A woken reader goes in with the waiter woken before it,
+  // even if a writer is now at the head of the queue.
+  return !woken && lk->head && !lk->head->shared;
+}
+
+// Acquire lk, shared or exclusive, from call site pc.
+static void
+acquire1(struct sleeplock *lk, int shared, uint pc)
 {
+  struct sleepwaiter w;
+  uint64 t0, wait;
+  int contended, waited;
+
+  t0 = rdtsc();
+  contended = spinsleep(lk);
+  w.shared = shared;
+  w.queued = 0;
+  waited = 0;
   acquire(&lk->lk);
-  while (lk->locked) {
-    sleep(lk, &lk->lk);
+  while(mustwait(lk, &w, waited && !w.queued)){
+    contended = 1;
+    if(!w.queued){
+      w.queued = 1;
+      if(waited){
+        // Woken, but another process got the lock first:
+        // keep w's place at the front of the queue.
+        w.next = lk->head;
+        lk->head = &w;
+        if(lk->tail == 0)
+          lk->tail = &w;
+      } else {
+        w.next = 0;
+        if(lk->tail)
+          lk->tail->next = &w;
+        else
+          lk->head = &w;
+        lk->tail = &w;
+      }
+    }
+    waited = 1;
+    // releasesleep() dequeues w before waking it, but
+    // kill() can wake it while still queued.
+    sleep(&w, &lk->lk);
+  }
+  if(w.queued)
+    dequeue(lk, &w);
+  if(shared)
+    lk->readers++;
+  else {
+    lk->locked = 1;
+    lk->proc = myproc();
+    lk->pid = myproc()->pid;
+  }
+  if(lk->class){
+    wait = contended ? rdtsc() - t0 : 0;
+    lockacquired(lk->class, lk->lk.cpu - cpus, pc, wait);
   }
-  lk->locked = 1;
-  lk->pid = myproc()->pid;
+  if(!shared)
+    lk->tacquire = rdtsc();
   release(&lk->lk);
 }
 
+// Sleep locks are taken through wrappers like ilock and
+// bread, so the call site recorded for profiling is the
+// caller's caller.
+
+void
+acquiresleep(struct sleeplock *lk)
+{
+  uint pcs[10];
+
+  getcallerpcs(&lk, pcs);
+  acquire1(lk, 0, pcs[1]);
+}
+
+void
+acquiresleep_shared(struct sleeplock *lk)
+{
+  uint pcs[10];
+
+  getcallerpcs(&lk, pcs);
+  acquire1(lk, 1, pcs[1]);
+}
+
+// Release lk, whether held shared or exclusive.
 void
 releasesleep(struct sleeplock *lk)
 {
+  struct sleepwaiter *w;
+
   acquire(&lk->lk);
-  lk->locked = 0;
-  lk->pid = 0;
-  wakeup(lk);
+  if(lk->locked){
+    if(lk->class)
+      lockreleased(lk->class, lk->lk.cpu - cpus, rdtsc() - lk->tacquire);
+    lk->locked = 0;
+    lk->proc = 0;
+    lk->pid = 0;
+  } else
+    lk->readers--;
+  // If another process takes the lock first, the woken
+  // waiters will queue themselves again, at the front.
+  if(lk->readers == 0){
+    while((w = lk->head) != 0){
+      dequeue(lk, w);
+      wakeup(w);
+      if(!w->shared || lk->head == 0 || !lk->head->shared)
+        break;
+    }
+  }
   release(&lk->lk);
 }
 
@@ -47,7 +208,7 @@ holdingsleep(struct sleeplock *lk)
   int r;
   
   acquire(&lk->lk);
-  r = lk->locked;
+  r = lk->locked || lk->readers;
   release(&lk->lk);
   return r;
 }
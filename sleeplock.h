@@ -1,10 +1,27 @@
-// Long-term locks for processes
+// A process waiting for a sleep lock.  Lives on the
+// waiter's stack while it is queued.
+struct sleepwaiter {
+  int shared;        // Waiting to share the lock?
+  int queued;        // On the lock's queue?
+  struct sleepwaiter *next;
+};
+
+// Long-term locks for processes.  Can be held exclusively
+// by one process, or shared by any number of readers.
 struct sleeplock {
-  uint locked;       // Is the lock held?
+  uint locked;       // Is the lock held exclusively?
+  int readers;       // Number of processes sharing the lock
   struct spinlock lk; // spinlock protecting this sleep lock
-  
+  struct sleepwaiter *head;  // Queue of sleeping waiters, oldest first
+  struct sleepwaiter *tail;
+  struct proc *proc; // Process holding lock, for adaptive spinning
+
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+
+  // For profiling:
+  struct lockclass *class;  // Counters for all locks with this name
+  uint64 tacquire;          // Time stamp of the acquisition
 };
 
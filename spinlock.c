@@ -13,24 +13,40 @@ void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
-  lk->locked = 0;
+  lk->next = 0;
+  lk->owner = 0;
   lk->cpu = 0;
+  lk->class = lockclassalloc(name, 0);
 }
 
 // Acquire the lock.
 // Loops (spins) until the lock is acquired.
 // Holding a lock for a long time may cause
 // other CPUs to waste time spinning to acquire it.
+//
+// This is a ticket lock: each acquirer takes the next
+// ticket and waits until lk->owner reaches it, so waiters
+// are served in arrival order.  While waiting a CPU only
+// reads lk->owner, which is written once per release.
 void
 acquire(struct spinlock *lk)
 {
+  uint ticket;
+  uint64 wait;
+
   pushcli(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
-  // The xchg is atomic.
-  while(xchg(&lk->locked, 1) != 0)
-    ;
+  // The xadd is atomic.
+  ticket = xadd(&lk->next, 1);
+  wait = 0;
+  if(lk->owner != ticket){
+    wait = rdtsc();
+    while(lk->owner != ticket)
+      pause();
+    wait = rdtsc() - wait;
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,6 +56,10 @@ acquire(struct spinlock *lk)
   // Record info about lock acquisition for debugging.
   lk->cpu = mycpu();
   getcallerpcs(&lk, lk->pcs);
+
+  if(lk->class)
+    lockacquired(lk->class, lk->cpu - cpus, lk->pcs[0], wait);
+  lk->tacquire = rdtsc();
 }
 
 // Release the lock.
@@ -49,6 +69,9 @@ release(struct spinlock *lk)
   if(!holding(lk))
     panic("release");
 
+  if(lk->class)
+    lockreleased(lk->class, lk->cpu - cpus, rdtsc() - lk->tacquire);
+
   lk->pcs[0] = 0;
   lk->cpu = 0;
 
@@ -59,10 +82,11 @@ release(struct spinlock *lk)
   // stores; __sync_synchronize() tells them both not to.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code can't use a C assignment, since it might
-  // not be atomic. A real OS would use C atomics here.
-  asm volatile("movl $0, %0" : "+m" (lk->locked) : );
+  // Release the lock by serving the next ticket, equivalent to
+  // lk->owner++.  Only the holder writes lk->owner, so a single
+  // store is enough, but this code can't use a C assignment,
+  // since it might not be atomic. A real OS would use C atomics here.
+  asm volatile("movl %1, %0" : "=m" (lk->owner) : "r" (lk->owner + 1));
 
   popcli();
 }
@@ -89,7 +113,7 @@ getcallerpcs(void *v, uint pcs[])
 int
 holding(struct spinlock *lock)
 {
-  return lock->locked && lock->cpu == mycpu();
+  return lock->next != lock->owner && lock->cpu == mycpu();
 }
 
 
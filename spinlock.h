@@ -1,11 +1,31 @@
 // Mutual exclusion lock.
 struct spinlock {
-  uint locked;       // Is the lock held?
+  volatile uint next;   // Next ticket to hand out
+  volatile uint owner;  // Ticket now being served (held if != next)
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
   uint pcs[10];      // The call stack (an array of program counters)
                      // that locked the lock.
+
+  // For profiling:
+  struct lockclass *class;  // Counters for all locks with this name
+  uint64 tacquire;          // Time stamp of the acquisition
+};
+
+// Contention counters, shared by all locks that were
+// initialized with the same name.  Each CPU updates only
+// its own slot, so no lock is needed to maintain them.
+struct lockcount {
+  uint nacquire;     // Acquisitions
+  uint ncontend;     // Acquisitions that had to wait
+  uint64 wait;       // Cycles spent waiting to acquire
+  uint64 hold;       // Cycles spent holding
 };
 
+struct lockclass {
+  char *name;
+  int sleep;         // Sleep locks (vs spin locks)?
+  struct lockcount cpu[NCPU];
+};
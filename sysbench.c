@@ -0,0 +1,99 @@
+// Measure the round-trip cost of system calls.
+//
+// usage: sysbench [rounds]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+#include "syscall.h"
+#include "traps.h"
+#include "clock.h"
+
+#define LOGN 16          // 2^LOGN calls per measurement
+#define N (1 << LOGN)
+
+struct bench {
+  char *name;
+  void (*f)(void);
+};
+
+void
+bgetpid(void)
+{
+  int i;
+
+  for(i = 0; i < N; i++)
+    getpid();
+}
+
+// getpid through the int $T_SYSCALL path, for comparison
+// with the sysenter path in usys.S.
+void
+bgetpidint(void)
+{
+  int i, pid;
+
+  for(i = 0; i < N; i++)
+    asm volatile("int %1" : "=a" (pid) : "i" (T_SYSCALL), "a" (SYS_getpid));
+}
+
+void
+buptime(void)
+{
+  int i;
+
+  for(i = 0; i < N; i++)
+    uptime();
+}
+
+void
+bclockgettime(void)
+{
+  struct timespec ts;
+  int i;
+
+  for(i = 0; i < N; i++)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+}
+
+// The same clock, read from the clock page.
+void
+bclockread(void)
+{
+  struct timespec ts;
+  int i;
+
+  for(i = 0; i < N; i++)
+    clock_read(&ts);
+}
+
+struct bench benches[] = {
+  { "getpid", bgetpid },  // null system call
+  { "getpid-int", bgetpidint },
+  { "uptime", buptime },  // takes a lock
+  { "clock_gettime", bclockgettime },
+  { "clock_read", bclockread },
+};
+
+int
+main(int argc, char *argv[])
+{
+  struct bench *b;
+  uint64 t;
+  int i, rounds;
+
+  rounds = 3;
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+
+  for(b = benches; b < &benches[sizeof(benches)/sizeof(benches[0])]; b++){
+    for(i = 0; i < rounds; i++){
+      t = rdtsc();
+      b->f();
+      t = rdtsc() - t;
+      printf(1, "%s: %d cycles/call\n", b->name, (uint)(t >> LOGN));
+    }
+  }
+  exit();
+}
@@ -103,6 +103,19 @@ extern int sys_unlink(void);
 extern int sys_wait(void);
 extern int sys_write(void);
 extern int sys_uptime(void);
+extern int sys_splice(void);
+extern int sys_readv(void);
+extern int sys_writev(void);
+extern int sys_lseek(void);
+extern int sys_pread(void);
+extern int sys_pwrite(void);
+extern int sys_fdlimit(void);
+extern int sys_ioctl(void);
+extern int sys_irqaffinity(void);
+extern int sys_trace(void);
+extern int sys_getprocinfo(void);
+extern int sys_clock_gettime(void);
+extern int sys_nanosleep(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -126,17 +139,60 @@ static int (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_splice]  sys_splice,
+[SYS_readv]   sys_readv,
+[SYS_writev]  sys_writev,
+[SYS_lseek]   sys_lseek,
+[SYS_pread]   sys_pread,
+[SYS_pwrite]  sys_pwrite,
+[SYS_fdlimit] sys_fdlimit,
+[SYS_ioctl]   sys_ioctl,
+[SYS_irqaffinity] sys_irqaffinity,
+[SYS_trace]   sys_trace,
+[SYS_getprocinfo] sys_getprocinfo,
+[SYS_clock_gettime] sys_clock_gettime,
+[SYS_nanosleep] sys_nanosleep,
 };
 
+// Histogram bucket for a latency of t cycles: log2(t).
+static int
+bucket(uint64 t)
+{
+  int b;
+
+  for(b = 0; b < NSYSHIST-1 && (t >>= 1) != 0; b++)
+    ;
+  return b;
+}
+
 void
 syscall(void)
 {
-  int num;
+  int i, num, traced;
+  uint arg[3];
+  uint64 t;
+  struct cpu *c;
   struct proc *curproc = myproc();
 
   num = curproc->tf->eax;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
+    pushcli();
+    mycpu()->nsyscall[num]++;
+    popcli();
+    if((traced = tracing(curproc)) != 0)
+      for(i = 0; i < NELEM(arg); i++)
+        if(argint(i, (int*)&arg[i]) < 0)
+          arg[i] = 0;
+    t = rdtsc();
     curproc->tf->eax = syscalls[num]();
+    t = rdtsc() - t;
+    pushcli();
+    c = mycpu();
+    c->syscycles[num] += t;
+    c->syshist[num][bucket(t)]++;
+    popcli();
+    if(traced)
+      tracelog(num, arg, curproc->tf->eax, t);
   } else {
     cprintf("%d %s: unknown sys call %d\n",
             curproc->pid, curproc->name, num);
@@ -20,3 +20,16 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_splice 22
+#define SYS_readv  23
+#define SYS_writev 24
+#define SYS_lseek  25
+#define SYS_pread  26
+#define SYS_pwrite 27
+#define SYS_fdlimit 28
+#define SYS_ioctl  29
+#define SYS_irqaffinity 30
+#define SYS_trace  31
+#define SYS_getprocinfo 32
+#define SYS_clock_gettime 33
+#define SYS_nanosleep 34
@@ -15,6 +15,7 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "uio.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -26,7 +27,7 @@ argfd(int n, int *pfd, struct file **pf)
 
   if(argint(n, &fd) < 0)
     return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if(fd < 0 || fd >= myproc()->nofile || (f=myproc()->ofile[fd]) == 0)
     return -1;
   if(pfd)
     *pfd = fd;
@@ -35,23 +36,6 @@ argfd(int n, int *pfd, struct file **pf)
   return 0;
 }
 
-// Allocate a file descriptor for the given file.
-// Takes over file reference from caller on success.
-static int
-fdalloc(struct file *f)
-{
-  int fd;
-  struct proc *curproc = myproc();
-
-  for(fd = 0; fd < NOFILE; fd++){
-    if(curproc->ofile[fd] == 0){
-      curproc->ofile[fd] = f;
-      return fd;
-    }
-  }
-  return -1;
-}
-
 int
 sys_dup(void)
 {
@@ -90,6 +74,136 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
+int
+sys_pread(void)
+{
+  struct file *f;
+  int n, off;
+  char *p;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0 ||
+     argint(3, &off) < 0 || off < 0)
+    return -1;
+  return filepread(f, p, n, off);
+}
+
+int
+sys_pwrite(void)
+{
+  struct file *f;
+  int n, off;
+  char *p;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0 ||
+     argint(3, &off) < 0 || off < 0)
+    return -1;
+  return filepwrite(f, p, n, off);
+}
+
+int
+sys_lseek(void)
+{
+  struct file *f;
+  int off, whence;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &off) < 0 || argint(2, &whence) < 0)
+    return -1;
+  return fileseek(f, off, whence);
+}
+
+// Copy the nth system call argument, an array of cnt iovecs,
+// into kiov, and check that the buffers they describe lie
+// within the process address space.  The copy is what gets
+// used, since a read into one buffer could change the array.
+static int
+argiov(int n, int cnt, struct iovec *kiov)
+{
+  struct iovec *iov;
+  struct proc *curproc = myproc();
+  uint base;
+  int i;
+
+  if(cnt < 0 || cnt > MAXIOV)
+    return -1;
+  if(argptr(n, (void*)&iov, cnt*sizeof(*iov)) < 0)
+    return -1;
+  memmove(kiov, iov, cnt*sizeof(*iov));
+  for(i = 0; i < cnt; i++){
+    base = (uint)kiov[i].base;
+    if(kiov[i].len < 0 || base >= curproc->sz ||
+       kiov[i].len > curproc->sz - base)
+      return -1;
+  }
+  return 0;
+}
+
+// Read into each buffer in turn, stopping early at
+// a short read.
+int
+sys_readv(void)
+{
+  struct file *f;
+  struct iovec kiov[MAXIOV];
+  int cnt, i, r, tot;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &cnt) < 0 || argiov(1, cnt, kiov) < 0)
+    return -1;
+  tot = 0;
+  for(i = 0; i < cnt; i++){
+    if((r = fileread(f, kiov[i].base, kiov[i].len)) < 0)
+      return tot > 0 ? tot : -1;
+    tot += r;
+    if(r < kiov[i].len)
+      break;
+  }
+  return tot;
+}
+
+// Write each buffer in turn.
+int
+sys_writev(void)
+{
+  struct file *f;
+  struct iovec kiov[MAXIOV];
+  int cnt, i, r, tot;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &cnt) < 0 || argiov(1, cnt, kiov) < 0)
+    return -1;
+  tot = 0;
+  for(i = 0; i < cnt; i++){
+    if((r = filewrite(f, kiov[i].base, kiov[i].len)) < 0)
+      return tot > 0 ? tot : -1;
+    tot += r;
+  }
+  return tot;
+}
+
+int
+sys_ioctl(void)
+{
+  struct file *f;
+  int req, arg;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &req) < 0 || argint(2, &arg) < 0)
+    return -1;
+  return fileioctl(f, req, arg);
+}
+
+// Set the limit on open files to n, if n is positive.
+// Return the previous limit.
+int
+sys_fdlimit(void)
+{
+  int n, old;
+
+  if(argint(0, &n) < 0)
+    return -1;
+  old = myproc()->fdlimit;
+  if(n > 0 && fdsetlimit(n) < 0)
+    return -1;
+  return old;
+}
+
 int
 sys_close(void)
 {
@@ -98,11 +212,24 @@ sys_close(void)
 
   if(argfd(0, &fd, &f) < 0)
     return -1;
-  myproc()->ofile[fd] = 0;
+  fdfree(fd);
   fileclose(f);
   return 0;
 }
 
+// Move up to n bytes from fdin to fdout without
+// copying them through user space.
+int
+sys_splice(void)
+{
+  struct file *fin, *fout;
+  int n;
+
+  if(argfd(0, 0, &fin) < 0 || argfd(1, 0, &fout) < 0 || argint(2, &n) < 0)
+    return -1;
+  return filesplice(fin, fout, n);
+}
+
 int
 sys_fstat(void)
 {
@@ -434,7 +561,7 @@ sys_pipe(void)
   fd0 = -1;
   if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
     if(fd0 >= 0)
-      myproc()->ofile[fd0] = 0;
+      fdfree(fd0);
     fileclose(rf);
     fileclose(wf);
     return -1;
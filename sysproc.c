@@ -6,6 +6,8 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "procinfo.h"
+#include "clock.h"
 
 int
 sys_fork(void)
@@ -89,3 +91,72 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// Route IRQ n to the CPUs in mask, bit i for cpus[i].
+// Return the previous mask.
+int
+sys_irqaffinity(void)
+{
+  int irq, mask;
+
+  if(argint(0, &irq) < 0 || argint(1, &mask) < 0)
+    return -1;
+  return ioapicaffinity(irq, mask);
+}
+
+// Start a trace session that logs this process's system
+// calls, and those of the children it forks, if on is
+// non-zero; stop if zero (see tracing() in proc.c).
+// Return whether this process was being traced.
+int
+sys_trace(void)
+{
+  int on, old;
+  struct proc *p = myproc();
+
+  if(argint(0, &on) < 0)
+    return -1;
+  old = tracing(p);
+  p->trace = on ? p->pid : 0;
+  return old;
+}
+
+int
+sys_clock_gettime(void)
+{
+  int clk;
+  struct timespec *ts;
+
+  if(argint(0, &clk) < 0 || argptr(1, (char**)&ts, sizeof(*ts)) < 0)
+    return -1;
+  if(clk != CLOCK_MONOTONIC)
+    return -1;
+  clockread(ts);
+  return 0;
+}
+
+int
+sys_nanosleep(void)
+{
+  struct timespec *ts;
+
+  if(argptr(0, (char**)&ts, sizeof(*ts)) < 0 || ts->nsec >= 1000000000)
+    return -1;
+  return clocksleep(ts->sec * (uint64)1000000000 + ts->nsec);
+}
+
+// Fill in up to n procinfos; return how many.
+int
+sys_getprocinfo(void)
+{
+  struct procinfo *pi;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > NPROC)
+    n = NPROC;
+  if(argptr(0, (char**)&pi, n*sizeof(*pi)) < 0)
+    return -1;
+  return procinfo(pi, n);
+}
@@ -0,0 +1,136 @@
+// The monotonic clock (see clock.h), with the TSC calibrated
+// against the Intel 8253/8254 Programmable Interval Timer.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "x86.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "clock.h"
+
+#define PIT_HZ       1193182           // PIT input clock
+#define PIT_LATCH    (PIT_HZ / 20)     // Count for 50 ms
+#define PIT_NS       ((uint)((uint64)PIT_LATCH * 1000000000 / PIT_HZ))
+
+#define PIT_CH2      0x42
+#define PIT_MODE     0x43
+#define PIT_GATE     0x61    // Channel 2 gate (bit 0), output (bit 5)
+
+// Mapped at CLOCKPAGE by setupkvm().
+char clockpage[PGSIZE] __attribute__((aligned(PGSIZE)));
+
+static struct clockpage *clock = (struct clockpage*)clockpage;
+
+// n / d, without libgcc.
+static uint64
+udiv(uint64 n, uint d)
+{
+  uint64 q, r;
+  int i;
+
+  q = r = 0;
+  for(i = 63; i >= 0; i--){
+    r = (r << 1) | ((n >> i) & 1);
+    if(r >= d){
+      r -= d;
+      q |= (uint64)1 << i;
+    }
+  }
+  return q;
+}
+
+// Count TSC cycles while PIT channel 2 counts down PIT_LATCH.
+// Return 0 if it never finishes.
+static uint
+pitcycles(void)
+{
+  uint64 t0, t;
+
+  outb(PIT_GATE, (inb(PIT_GATE) & ~0x02) | 0x01);  // Speaker off
+  outb(PIT_MODE, 0xB0);  // Channel 2, lo/hi byte, mode 0
+  outb(PIT_CH2, PIT_LATCH & 0xFF);
+  outb(PIT_CH2, PIT_LATCH >> 8);
+  t0 = rdtsc();
+  while(!(inb(PIT_GATE) & 0x20)){
+    t = rdtsc() - t0;
+    if(t >> 36)
+      return 0;
+  }
+  return rdtsc() - t0;
+}
+
+void
+timerinit(void)
+{
+  uint cycles;
+
+  cycles = pitcycles();
+  if(cycles == 0){
+    cprintf("timer: cannot calibrate TSC, assuming 1 GHz\n");
+    cycles = PIT_NS;
+  }
+  clock->mult = udiv((uint64)PIT_NS << CLOCKSHIFT, cycles);
+  clock->tsc = rdtsc();
+  cprintf("timer: TSC %d MHz\n", cycles / (PIT_NS / 1000));
+}
+
+// Bring the clock page up to date.  Called by CPU 0 on each
+// timer tick.
+void
+clocktick(void)
+{
+  uint64 tsc, ns;
+
+  tsc = rdtsc();
+  ns = clock->nsec + clockscale(tsc - clock->tsc, clock->mult);
+
+  clock->seq++;
+  __sync_synchronize();
+  while(ns >= 1000000000){
+    ns -= 1000000000;
+    clock->sec++;
+  }
+  clock->nsec = ns;
+  clock->tsc = tsc;
+  __sync_synchronize();
+  clock->seq++;
+}
+
+void
+clockread(struct timespec *ts)
+{
+  clockget(clock, ts);
+}
+
+static uint64
+nsec(void)
+{
+  struct timespec ts;
+
+  clockget(clock, &ts);
+  return ts.sec * (uint64)1000000000 + ts.nsec;
+}
+
+// Sleep for at least ns nanoseconds.  The LAPIC timer ticks
+// are the only timer interrupts, so the sleep ends at the
+// first tick after the time is up: it is rounded up to a
+// tick boundary.
+int
+clocksleep(uint64 ns)
+{
+  uint64 end;
+
+  end = nsec() + ns;
+  acquire(&tickslock);
+  while(nsec() < end){
+    if(myproc()->killed){
+      release(&tickslock);
+      return -1;
+    }
+    sleep(&ticks, &tickslock);
+  }
+  release(&tickslock);
+  return 0;
+}
@@ -0,0 +1,128 @@
+// List processes and the CPU time each used over an
+// interval, busiest first.
+//
+// usage: top [-d ticks] [-n count]
+//
+// Lists every ticks timer ticks (default 100), count times
+// (default 1).  %CPU is the share of one CPU's ticks; TIME
+// is user+system ticks since the process started; VCSW and
+// IVCSW count sleeps and preemptions; RSS is in pages.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "procinfo.h"
+
+struct procinfo old[NPROC], cur[NPROC];
+int order[NPROC];
+uint used[NPROC];
+
+// Print s left-justified in a column of width w.
+void
+col(char *s, int w)
+{
+  int n;
+
+  n = strlen(s);
+  printf(1, "%s", s);
+  for(; n < w; n++)
+    printf(1, " ");
+}
+
+void
+ncol(uint x, int w)
+{
+  char buf[12];
+  char *p;
+
+  p = buf + sizeof(buf) - 1;
+  *p = 0;
+  do{
+    *--p = '0' + x % 10;
+  }while((x /= 10) != 0);
+  col(p, w);
+}
+
+// Ticks process i used since the last listing.
+uint
+delta(int nold, int i)
+{
+  int j;
+
+  for(j = 0; j < nold; j++)
+    if(old[j].pid == cur[i].pid)
+      return cur[i].utime + cur[i].stime - old[j].utime - old[j].stime;
+  return cur[i].utime + cur[i].stime;
+}
+
+void
+list(int n, int nold, uint dt)
+{
+  int i, j, t;
+  struct procinfo *p;
+
+  for(i = 0; i < n; i++){
+    order[i] = i;
+    used[i] = delta(nold, i);
+  }
+  for(i = 1; i < n; i++)
+    for(j = i; j > 0 && used[order[j]] > used[order[j-1]]; j--){
+      t = order[j];
+      order[j] = order[j-1];
+      order[j-1] = t;
+    }
+
+  printf(1, "PID   PPID  STATE   CPU %%CPU TIME    VCSW    IVCSW   FLT  RSS   NAME\n");
+  for(i = 0; i < n; i++){
+    p = &cur[order[i]];
+    ncol(p->pid, 6);
+    ncol(p->ppid, 6);
+    col(p->state, 8);
+    ncol(p->cpu, 4);
+    ncol(dt ? 100*used[order[i]]/dt : 0, 5);
+    ncol(p->utime + p->stime, 8);
+    ncol(p->nvcsw, 8);
+    ncol(p->nivcsw, 8);
+    ncol(p->nfault, 5);
+    ncol(p->rss, 6);
+    printf(1, "%s\n", p->name);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, nold, interval, count;
+  uint t0, t1;
+
+  interval = 100;
+  count = 1;
+  for(i = 1; i + 1 < argc; i += 2){
+    if(strcmp(argv[i], "-d") == 0)
+      interval = atoi(argv[i+1]);
+    else if(strcmp(argv[i], "-n") == 0)
+      count = atoi(argv[i+1]);
+    else
+      break;
+  }
+  if(i < argc || interval <= 0){
+    printf(2, "usage: top [-d ticks] [-n count]\n");
+    exit();
+  }
+
+  t0 = uptime();
+  nold = getprocinfo(old, NPROC);
+  while(count-- > 0){
+    sleep(interval);
+    t1 = uptime();
+    n = getprocinfo(cur, NPROC);
+    list(n, nold, t1 - t0);
+    if(count > 0)
+      printf(1, "\n");
+    memmove(old, cur, n*sizeof(cur[0]));
+    nold = n;
+    t0 = t1;
+  }
+  exit();
+}
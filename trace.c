@@ -0,0 +1,97 @@
+// System call tracing.
+//
+// A process that has called trace(1), and the children it
+// forks afterwards, log each system call they return from into
+// a ring buffer that all processes share: the call's number,
+// first three arguments, result and duration in cycles.  exit()
+// never returns, so it is not logged.  Each record names its
+// trace session, the pid of the process that called trace(1);
+// the session ends when that process calls trace(0) or exits.
+//
+// The trace device (major TRACE) reads out the ring as an
+// array of struct tracerec.  Offsets are absolute: the record
+// numbered seq, counting from boot, is at seq*sizeof(struct
+// tracerec), so a reader can pread() from just after the last
+// record it saw.  A read from an offset that the ring has
+// since overwritten starts at the oldest record still kept.
+// Writing to the device empties the ring.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "trace.h"
+
+#define NTRACE 1024  // records kept
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+static struct {
+  struct spinlock lock;
+  struct tracerec rec[NTRACE];
+  uint r;  // First record not emptied
+  uint w;  // Records ever logged
+} trace;
+
+void
+tracelog(int num, uint *arg, int ret, uint cycles)
+{
+  struct tracerec *t;
+
+  acquire(&trace.lock);
+  t = &trace.rec[trace.w % NTRACE];
+  t->seq = trace.w++;
+  t->session = myproc()->trace;
+  t->pid = myproc()->pid;
+  t->num = num;
+  memmove(t->arg, arg, sizeof(t->arg));
+  t->ret = ret;
+  t->cycles = cycles;
+  if(trace.w - trace.r > NTRACE)
+    trace.r = trace.w - NTRACE;
+  release(&trace.lock);
+}
+
+static int
+traceread(struct inode *ip, char *dst, uint off, int n)
+{
+  int tot, m, o;
+  uint i;
+
+  acquire(&trace.lock);
+  i = off / sizeof(struct tracerec);
+  o = off % sizeof(struct tracerec);
+  if(i < trace.r){
+    i = trace.r;
+    o = 0;
+  }
+  for(tot = 0; i < trace.w && tot < n; i++, o = 0){
+    m = min(n - tot, sizeof(struct tracerec) - o);
+    memmove(dst + tot, (char*)&trace.rec[i % NTRACE] + o, m);
+    tot += m;
+  }
+  release(&trace.lock);
+  return tot;
+}
+
+static int
+tracewrite(struct inode *ip, char *src, int n)
+{
+  acquire(&trace.lock);
+  trace.r = trace.w;
+  release(&trace.lock);
+  return n;
+}
+
+void
+traceinit(void)
+{
+  initlock(&trace.lock, "trace");
+  devsw[TRACE].read = traceread;
+  devsw[TRACE].write = tracewrite;
+}
@@ -0,0 +1,10 @@
+// A traced system call, as read from the trace device.
+struct tracerec {
+  uint seq;      // Position in the log; read at seq*sizeof(struct tracerec)
+  int session;   // Pid of the process that called trace(1)
+  int pid;
+  int num;       // System call number
+  uint arg[3];   // First three arguments
+  int ret;       // Return value
+  uint cycles;   // Time taken
+};
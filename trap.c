@@ -7,11 +7,19 @@
 #include "x86.h"
 #include "traps.h"
 #include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "clock.h"
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
 
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
+extern void sysentry(void);  // in trapasm.S
 struct spinlock tickslock;
+int nosysenter;  // Some cpu lacks sysenter
 uint ticks;
 
 void
@@ -32,6 +40,29 @@ idtinit(void)
   lidt(idt, sizeof(idt));
 }
 
+// Set up this cpu's MSRs for the sysenter system call path.
+// sysenter loads %cs from MSR_SYSENTER_CS and %ss from the
+// next descriptor; sysexit uses the two after that, which is
+// why SEG_KCODE, SEG_KDATA, SEG_UCODE and SEG_UDATA must be in
+// that order.  switchuvm() sets MSR_SYSENTER_ESP.
+// A cpu without sysenter has no such MSRs; then the clock page
+// tells the usys.S stubs to use int $T_SYSCALL instead.
+void
+sysenterinit(void)
+{
+  uint r[4];
+
+  cpuinfo(1, r);
+  if(!(r[3] & CPUID_SEP)){
+    cprintf("cpu%d: no sysenter, using int $T_SYSCALL\n", cpuid());
+    nosysenter = 1;
+    ((struct clockpage*)clockpage)->nosysenter = 1;
+    return;
+  }
+  wrmsr(MSR_SYSENTER_CS, SEG_KCODE << 3);
+  wrmsr(MSR_SYSENTER_EIP, (uint)sysentry);
+}
+
 //PAGEBREAK: 41
 void
 trap(struct trapframe *tf)
@@ -46,14 +77,30 @@ trap(struct trapframe *tf)
     return;
   }
 
+  mycpu()->ntrap[tf->trapno]++;
+  if(tf->trapno == T_PGFLT && myproc())
+    myproc()->nfault++;
   switch(tf->trapno){
   case T_IRQ0 + IRQ_TIMER:
     if(cpuid() == 0){
       acquire(&tickslock);
       ticks++;
+      clocktick();
       wakeup(&ticks);
       release(&tickslock);
+      klogdrain();
+    }
+    if(myproc() && myproc()->state == RUNNING){
+      if((tf->cs&3) == DPL_USER)
+        myproc()->utime++;
+      else
+        myproc()->stime++;
     }
+    proftick(tf);
+    lapiceoi();
+    break;
+  case T_IRQ0 + IRQ_PERF:
+    profpmi(tf);
     lapiceoi();
     break;
   case T_IRQ0 + IRQ_IDE:
@@ -71,6 +118,10 @@ trap(struct trapframe *tf)
     uartintr();
     lapiceoi();
     break;
+  case T_IRQ0 + IRQ_WAKEUP:
+    // Nothing to do; scheduler() rescans once the hlt returns.
+    lapiceoi();
+    break;
   case T_IRQ0 + 7:
   case T_IRQ0 + IRQ_SPURIOUS:
     cprintf("cpu%d: spurious interrupt at %x:%x\n",
@@ -109,3 +160,46 @@ trap(struct trapframe *tf)
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
 }
+
+//PAGEBREAK!
+// The trapstat device (major TRAPSTAT) reads out each CPU's
+// trap and system call counts, as an array of struct trapstat.
+// A record is too big for the stack, so copy each of its
+// fields straight from struct cpu.
+static int
+trapstatread(struct inode *ip, char *dst, uint off, int n)
+{
+  struct cpu *c;
+  char *src[4];
+  uint size[4], pos, lo, hi;
+  int i, tot;
+
+  tot = 0;
+  pos = 0;  // Offset of src[i] in the device
+  for(c = cpus; c < cpus+ncpu; c++){
+    src[0] = (char*)c->ntrap;
+    size[0] = sizeof(c->ntrap);
+    src[1] = (char*)c->nsyscall;
+    size[1] = sizeof(c->nsyscall);
+    src[2] = (char*)c->syscycles;
+    size[2] = sizeof(c->syscycles);
+    src[3] = (char*)c->syshist;
+    size[3] = sizeof(c->syshist);
+    for(i = 0; i < 4; i++){
+      lo = pos > off ? pos : off;
+      hi = min(pos + size[i], off + n);
+      if(lo < hi){
+        memmove(dst + lo - off, src[i] + lo - pos, hi - lo);
+        tot += hi - lo;
+      }
+      pos += size[i];
+    }
+  }
+  return tot;
+}
+
+void
+trapstatinit(void)
+{
+  devsw[TRAPSTAT].read = trapstatread;
+}
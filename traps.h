@@ -34,5 +34,9 @@
 #define IRQ_COM1         4
 #define IRQ_IDE         14
 #define IRQ_ERROR       19
+#define IRQ_PERF        29      // performance counter overflow
+#define IRQ_WAKEUP      30      // IPI: work is waiting for a halted CPU
 #define IRQ_SPURIOUS    31
 
+#define NIRQ            32      // IRQs, vectors T_IRQ0 to T_IRQ0+NIRQ-1
+
@@ -0,0 +1,268 @@
+// Print trap and system call counts per CPU, and the cycles
+// spent in each system call; or trace a command's system calls.
+//
+// usage: trapstat [-h]          print the counts since boot
+//        trapstat [-h] cmd ...  run cmd and print the counts
+//                               while it ran
+//        trapstat -t cmd ...    run cmd and print each system
+//                               call it and its children make
+//
+// -h adds a latency histogram for each system call.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "param.h"
+#include "traps.h"
+#include "syscall.h"
+#include "trapstat.h"
+#include "trace.h"
+
+#define NELEM(x) (sizeof(x)/sizeof((x)[0]))
+
+struct trapstat before[NCPU], after[NCPU];
+struct tracerec rec[64];
+
+char *trapname[] = {
+[T_DIVIDE]   "divide",
+[T_DEBUG]    "debug",
+[T_NMI]      "nmi",
+[T_BRKPT]    "brkpt",
+[T_OFLOW]    "oflow",
+[T_BOUND]    "bound",
+[T_ILLOP]    "illop",
+[T_DEVICE]   "device",
+[T_DBLFLT]   "dblflt",
+[T_TSS]      "tss",
+[T_SEGNP]    "segnp",
+[T_STACK]    "stack",
+[T_GPFLT]    "gpflt",
+[T_PGFLT]    "pgflt",
+[T_FPERR]    "fperr",
+[T_ALIGN]    "align",
+[T_MCHK]     "mchk",
+[T_SIMDERR]  "simderr",
+[T_IRQ0+IRQ_TIMER]     "timer",
+[T_IRQ0+IRQ_KBD]       "kbd",
+[T_IRQ0+IRQ_COM1]      "com1",
+[T_IRQ0+IRQ_IDE]       "ide",
+[T_IRQ0+IRQ_ERROR]     "error",
+[T_IRQ0+IRQ_PERF]      "perf",
+[T_IRQ0+IRQ_WAKEUP]    "wakeup",
+[T_IRQ0+IRQ_SPURIOUS]  "spurious",
+};
+
+char *sysname[] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_splice]  "splice",
+[SYS_readv]   "readv",
+[SYS_writev]  "writev",
+[SYS_lseek]   "lseek",
+[SYS_pread]   "pread",
+[SYS_pwrite]  "pwrite",
+[SYS_fdlimit] "fdlimit",
+[SYS_ioctl]   "ioctl",
+[SYS_irqaffinity] "irqaffinity",
+[SYS_trace]   "trace",
+[SYS_getprocinfo] "getprocinfo",
+[SYS_clock_gettime] "clock_gettime",
+[SYS_nanosleep] "nanosleep",
+};
+
+int
+devopen(char *name, int mode)
+{
+  int fd;
+
+  if((fd = open(name, mode)) < 0){
+    printf(2, "trapstat: cannot open %s\n", name);
+    exit();
+  }
+  return fd;
+}
+
+// Read one record per CPU into st; return the number of CPUs.
+int
+readstats(struct trapstat *st)
+{
+  int fd, n;
+
+  fd = devopen("/dev/trapstat", O_RDONLY);
+  n = read(fd, st, NCPU*sizeof(st[0])) / sizeof(st[0]);
+  close(fd);
+  return n;
+}
+
+char*
+name(char **names, int nnames, int i)
+{
+  static char buf[12];
+  char *p;
+
+  if(i < nnames && names[i])
+    return names[i];
+  p = buf + sizeof(buf) - 1;
+  *p = 0;
+  do{
+    *--p = '0' + i % 10;
+  }while((i /= 10) != 0);
+  return p;
+}
+
+// Print a line for a counter that changed on some CPU, without
+// the newline.  Return the total change.
+uint
+line(char *name, uint *b, uint *a, int stride, int ncpu)
+{
+  int c;
+  uint tot;
+
+  tot = 0;
+  for(c = 0; c < ncpu; c++)
+    tot += a[c*stride] - b[c*stride];
+  if(tot == 0)
+    return 0;
+  printf(1, "%s", name);
+  for(c = 0; c < ncpu; c++)
+    printf(1, " %d", a[c*stride] - b[c*stride]);
+  printf(1, " %d", tot);
+  return tot;
+}
+
+void
+print(int ncpu, int hist)
+{
+  int i, j, c, stride;
+  uint64 cycles;
+  uint n;
+
+  // Consecutive CPUs' counts for one trap are a record apart.
+  stride = sizeof(struct trapstat) / sizeof(uint);
+
+  printf(1, "trap");
+  for(c = 0; c < ncpu; c++)
+    printf(1, " cpu%d", c);
+  printf(1, " total\n");
+  for(i = 0; i < 256; i++)
+    if(line(name(trapname, NELEM(trapname), i),
+            &before[0].ntrap[i], &after[0].ntrap[i], stride, ncpu))
+      printf(1, "\n");
+
+  printf(1, "\nsyscall");
+  for(c = 0; c < ncpu; c++)
+    printf(1, " cpu%d", c);
+  printf(1, " total kcycles\n");
+  for(i = 0; i < NSYSCALL; i++){
+    if(line(name(sysname, NELEM(sysname), i),
+            &before[0].nsyscall[i], &after[0].nsyscall[i], stride, ncpu) == 0)
+      continue;
+    cycles = 0;
+    for(c = 0; c < ncpu; c++)
+      cycles += after[c].syscycles[i] - before[c].syscycles[i];
+    printf(1, " %d\n", (uint)(cycles >> 10));
+    if(!hist)
+      continue;
+    for(j = 0; j < NSYSHIST; j++){
+      n = 0;
+      for(c = 0; c < ncpu; c++)
+        n += after[c].syshist[i][j] - before[c].syshist[i][j];
+      if(n)
+        printf(1, "  2^%d cycles: %d\n", j, n);
+    }
+  }
+}
+
+// Print the records in the trace device from session.
+void
+printtrace(int session)
+{
+  int fd, i, n;
+  uint off;
+  struct tracerec *t;
+
+  fd = devopen("/dev/trace", O_RDONLY);
+  off = 0;
+  while((n = pread(fd, rec, sizeof(rec), off) / sizeof(rec[0])) > 0){
+    off = (rec[n-1].seq + 1) * sizeof(rec[0]);
+    for(i = 0; i < n; i++){
+      t = &rec[i];
+      if(t->session != session)
+        continue;
+      printf(1, "%d %s(%x, %x, %x) = %d, %d cycles\n", t->pid,
+             name(sysname, NELEM(sysname), t->num),
+             t->arg[0], t->arg[1], t->arg[2], t->ret, t->cycles);
+    }
+  }
+  close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ncpu, hist, tracing, fd, pid;
+
+  hist = tracing = 0;
+  for(; argc > 1 && argv[1][0] == '-'; argc--, argv++){
+    if(strcmp(argv[1], "-h") == 0)
+      hist = 1;
+    else if(strcmp(argv[1], "-t") == 0)
+      tracing = 1;
+    else {
+      printf(2, "usage: trapstat [-h] [-t] [cmd ...]\n");
+      exit();
+    }
+  }
+
+  if(argc < 2){
+    ncpu = readstats(after);
+    print(ncpu, hist);
+    exit();
+  }
+
+  if(tracing){
+    fd = devopen("/dev/trace", O_WRONLY);
+    write(fd, "", 1);
+    close(fd);
+  }
+  readstats(before);
+  switch(pid = fork()){
+  case -1:
+    printf(2, "trapstat: fork failed\n");
+    exit();
+  case 0:
+    if(tracing)
+      trace(1);
+    exec(argv[1], argv+1);
+    printf(2, "trapstat: exec %s failed\n", argv[1]);
+    exit();
+  }
+  wait();
+  if(tracing){
+    printtrace(pid);
+    exit();
+  }
+  ncpu = readstats(after);
+  print(ncpu, hist);
+  exit();
+}
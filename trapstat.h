@@ -0,0 +1,8 @@
+// Trap statistics, as read from the trapstat device: one
+// record per CPU.  Page faults are ntrap[T_PGFLT].
+struct trapstat {
+  uint ntrap[256];          // Traps other than system calls, by trapno
+  uint nsyscall[NSYSCALL];  // System calls, by number
+  uint64 syscycles[NSYSCALL];         // Cycles spent in them
+  uint syshist[NSYSCALL][NSYSHIST];   // Calls taking 2^i to 2^(i+1)-1 cycles
+};
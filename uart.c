@@ -1,4 +1,12 @@
 // Intel 8250 serial port (UART).
+//
+// Output goes into a ring buffer, and from there into the
+// 16550's transmit FIFO, which the transmit-empty interrupt
+// refills.  So uartputc() normally only queues a character,
+// and consolewrite() can hold cons.lock without waiting for
+// the line.  If the ring is full, uartputc() polls the UART
+// until there is room; consolewrite() avoids that by calling
+// uartwait() first, which sleeps instead.
 
 #include "types.h"
 #include "defs.h"
@@ -14,50 +22,122 @@
 
 #define COM1    0x3f8
 
+#define UARTBUF 1024  // transmit ring size
+
 static int uart;    // is there a uart?
 
+static struct {
+  struct spinlock lock;
+  char buf[UARTBUF];
+  uint r;       // number of characters sent to the UART
+  uint w;       // number of characters queued
+  int fifo;     // size of the UART's transmit FIFO
+  int txwait;   // a writer is sleeping on r
+  int sync;     // panicking: write directly, no lock
+} tx;
+
 void
 uartinit(void)
 {
   char *p;
 
-  // Turn off the FIFO
-  outb(COM1+2, 0);
+  // Turn on and clear the FIFOs.
+  outb(COM1+2, 0x07);
 
-  // 9600 baud, 8 data bits, 1 stop bit, parity off.
+  // 115200 baud, 8 data bits, 1 stop bit, parity off.
   outb(COM1+3, 0x80);    // Unlock divisor
-  outb(COM1+0, 115200/9600);
+  outb(COM1+0, 115200/115200);
   outb(COM1+1, 0);
   outb(COM1+3, 0x03);    // Lock divisor, 8 data bits.
   outb(COM1+4, 0);
-  outb(COM1+1, 0x01);    // Enable receive interrupts.
+  outb(COM1+1, 0x03);    // Enable receive and transmit-empty interrupts.
 
   // If status is 0xFF, no serial port.
   if(inb(COM1+5) == 0xFF)
     return;
   uart = 1;
 
+  // An 8250 or 16450 has no FIFO.
+  tx.fifo = (inb(COM1+2) & 0xC0) == 0xC0 ? 16 : 1;
+  initlock(&tx.lock, "uart");
+
   // Acknowledge pre-existing interrupt conditions;
   // enable interrupts.
   inb(COM1+2);
   inb(COM1+0);
-  ioapicenable(IRQ_COM1, 0);
+  ioapicenable(IRQ_COM1, ~0);
 
   // Announce that we're here.
   for(p="xv6...\n"; *p; p++)
     uartputc(*p);
 }
 
-void
-uartputc(int c)
+// Move queued characters into the transmit FIFO, if it is
+// empty.  Caller must hold tx.lock.
+static void
+uartstart(void)
 {
   int i;
 
+  if(tx.r == tx.w || !(inb(COM1+5) & 0x20))
+    return;
+  for(i = 0; i < tx.fifo && tx.r != tx.w; i++)
+    outb(COM1+0, tx.buf[tx.r++ % UARTBUF]);
+}
+
+void
+uartputc(int c)
+{
   if(!uart)
     return;
-  for(i = 0; i < 128 && !(inb(COM1+5) & 0x20); i++)
+  if(tx.sync){
+    while(!(inb(COM1+5) & 0x20))
+      microdelay(10);
+    outb(COM1+0, c);
+    return;
+  }
+
+  acquire(&tx.lock);
+  while(tx.w == tx.r + UARTBUF){
+    uartstart();
     microdelay(10);
-  outb(COM1+0, c);
+  }
+  tx.buf[tx.w++ % UARTBUF] = c;
+  uartstart();
+  release(&tx.lock);
+}
+
+// Sleep until n characters, or as many as the ring
+// holds, can be queued without polling.
+void
+uartwait(int n)
+{
+  if(!uart)
+    return;
+  if(n > UARTBUF)
+    n = UARTBUF;
+  acquire(&tx.lock);
+  while(UARTBUF - (tx.w - tx.r) < n){
+    tx.txwait = 1;
+    sleep(&tx.r, &tx.lock);
+  }
+  release(&tx.lock);
+}
+
+// Write out everything queued by polling, and have
+// uartputc() do the same from now on.  For panic(),
+// which may have interrupted a holder of tx.lock.
+void
+uartflush(void)
+{
+  if(!uart)
+    return;
+  tx.sync = 1;
+  while(tx.r != tx.w){
+    while(!(inb(COM1+5) & 0x20))
+      microdelay(10);
+    outb(COM1+0, tx.buf[tx.r++ % UARTBUF]);
+  }
 }
 
 static int
@@ -73,5 +153,16 @@ uartgetc(void)
 void
 uartintr(void)
 {
-  consoleintr(uartgetc);
+  // The interrupt is edge-triggered: handle every
+  // pending condition, or it might not come again.
+  while(!(inb(COM1+2) & 0x01)){
+    acquire(&tx.lock);
+    uartstart();
+    if(tx.txwait && tx.w - tx.r < UARTBUF){
+      tx.txwait = 0;
+      wakeup(&tx.r);
+    }
+    release(&tx.lock);
+    consoleintr(uartgetc);
+  }
 }
@@ -3,6 +3,9 @@
 #include "fcntl.h"
 #include "user.h"
 #include "x86.h"
+#include "param.h"
+#include "memlayout.h"
+#include "clock.h"
 
 char*
 strcpy(char *s, char *t)
@@ -92,6 +95,13 @@ atoi(const char *s)
   return n;
 }
 
+// clock_gettime(CLOCK_MONOTONIC, ts), without a system call.
+void
+clock_read(struct timespec *ts)
+{
+  clockget((struct clockpage*)CLOCKPAGE, ts);
+}
+
 void*
 memmove(void *vdst, void *vsrc, int n)
 {
@@ -103,3 +113,228 @@ memmove(void *vdst, void *vsrc, int n)
     *dst++ = *src++;
   return vdst;
 }
+
+//PAGEBREAK!
+// Buffered output.
+//
+// Output to each fd below NOFILE collects in a buffer.
+// Writes to the console are line buffered, writes to fd 2
+// are flushed at the end of each call, and writes to files
+// and pipes are flushed only when the buffer fills.  exit,
+// fork and exec flush every buffer first; close, write and
+// the other calls that use an fd's offset flush its own.
+// read also flushes the line-buffered fds, so that a prompt
+// shows before the program waits for input.
+
+#define BUFSIZ 512
+
+enum { IOUNSET, IOFULL, IOLINE, IOCALL };
+
+struct iobuf {
+  int mode;
+  int n;
+  char buf[BUFSIZ];
+};
+
+static struct iobuf iob[NOFILE];
+
+int _exit(void) __attribute__((noreturn));
+int _fork(void);
+int _close(int);
+int _exec(char*, char**);
+int _lseek(int, int, int);
+int _pread(int, void*, int, int);
+int _pwrite(int, void*, int, int);
+int _read(int, void*, int);
+int _readv(int, struct iovec*, int);
+int _write(int, void*, int);
+int _writev(int, struct iovec*, int);
+
+int
+fflush(int fd)
+{
+  struct iobuf *b;
+  int n;
+
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  b = &iob[fd];
+  n = b->n;
+  b->n = 0;
+  if(n > 0 && _write(fd, b->buf, n) != n)
+    return -1;
+  return 0;
+}
+
+void
+flushall(void)
+{
+  int fd;
+
+  for(fd = 0; fd < NOFILE; fd++)
+    fflush(fd);
+}
+
+// Flush the line-buffered (console) fds.
+static void
+flushline(void)
+{
+  int fd;
+
+  for(fd = 0; fd < NOFILE; fd++)
+    if(iob[fd].mode == IOLINE)
+      fflush(fd);
+}
+
+int
+fwrite(int fd, void *p, int n)
+{
+  struct iobuf *b;
+  struct stat st;
+  char *s;
+  int i, m, nl;
+
+  if(fd < 0 || fd >= NOFILE)
+    return _write(fd, p, n);
+  b = &iob[fd];
+  if(b->mode == IOUNSET){
+    if(fd == 2)
+      b->mode = IOCALL;
+    else if(fstat(fd, &st) == 0 && st.type == T_DEV)
+      b->mode = IOLINE;
+    else
+      b->mode = IOFULL;
+  }
+
+  // Large writes skip the buffer.
+  if(n >= BUFSIZ){
+    if(fflush(fd) < 0)
+      return -1;
+    return _write(fd, p, n);
+  }
+
+  s = p;
+  nl = 0;
+  for(i = 0; i < n; i += m){
+    if(b->n == BUFSIZ && fflush(fd) < 0)
+      return -1;
+    m = n - i;
+    if(m > BUFSIZ - b->n)
+      m = BUFSIZ - b->n;
+    memmove(b->buf + b->n, s + i, m);
+    b->n += m;
+  }
+  if(b->mode == IOLINE)
+    for(i = 0; i < n; i++)
+      if(s[i] == '\n')
+        nl = 1;
+  if(b->mode == IOCALL || nl)
+    if(fflush(fd) < 0)
+      return -1;
+  return n;
+}
+
+int
+fputs(int fd, char *s)
+{
+  return fwrite(fd, s, strlen(s));
+}
+
+int
+fputc(int fd, int c)
+{
+  char ch;
+
+  ch = c;
+  return fwrite(fd, &ch, 1) == 1 ? c : -1;
+}
+
+int
+exit(void)
+{
+  flushall();
+  _exit();
+}
+
+int
+fork(void)
+{
+  flushall();
+  return _fork();
+}
+
+int
+exec(char *path, char **argv)
+{
+  flushall();
+  return _exec(path, argv);
+}
+
+int
+close(int fd)
+{
+  fflush(fd);
+  if(fd >= 0 && fd < NOFILE)
+    iob[fd].mode = IOUNSET;
+  return _close(fd);
+}
+
+// Buffered output goes at the offset it was written at.
+
+int
+lseek(int fd, int off, int whence)
+{
+  if(fflush(fd) < 0)
+    return -1;
+  return _lseek(fd, off, whence);
+}
+
+int
+pread(int fd, void *p, int n, int off)
+{
+  if(fflush(fd) < 0)
+    return -1;
+  return _pread(fd, p, n, off);
+}
+
+int
+pwrite(int fd, void *p, int n, int off)
+{
+  if(fflush(fd) < 0)
+    return -1;
+  return _pwrite(fd, p, n, off);
+}
+
+int
+read(int fd, void *p, int n)
+{
+  if(fflush(fd) < 0)
+    return -1;
+  flushline();
+  return _read(fd, p, n);
+}
+
+int
+readv(int fd, struct iovec *iov, int n)
+{
+  if(fflush(fd) < 0)
+    return -1;
+  flushline();
+  return _readv(fd, iov, n);
+}
+
+int
+write(int fd, void *p, int n)
+{
+  if(fflush(fd) < 0)
+    return -1;
+  return _write(fd, p, n);
+}
+
+int
+writev(int fd, struct iovec *iov, int n)
+{
+  if(fflush(fd) < 0)
+    return -1;
+  return _writev(fd, iov, n);
+}
@@ -3,8 +3,15 @@
 #include "user.h"
 #include "param.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Memory allocator.
+//
+// Small requests are served from segregated free lists, one
+// per power-of-two size class, in O(1); each class is refilled
+// a page at a time from the large allocator.  Large requests
+// use the first-fit, coalescing free list of Kernighan and
+// Ritchie, The C programming Language, 2nd ed.  Section 8.7,
+// which gives memory back to the kernel with a negative sbrk
+// once a big enough free block sits at the top of the heap.
 
 typedef long Align;
 
@@ -18,15 +25,45 @@ union header {
 
 typedef union header Header;
 
+// In an allocated block, s.ptr is 0 for a large block, or
+// SMALL(c) for a block of size class c.
+#define NCLASS   8                    // classes of 16, 32, ..., 2048 bytes
+#define CLASSSZ(c) (16 << (c))        // block size, header included
+#define SMALL(c) ((Header*)((c) + 1))
+#define ISSMALL(p) ((uint)(p) - 1 < NCLASS)
+#define SLAB     4096                 // bytes to refill a class with
+#define TRIM     (64*1024)            // free top block size to give back
+
 static Header base;
 static Header *freep;
+static Header *smallfree[NCLASS];
 
-void
-free(void *ap)
+// Give the free block at the top of the heap, if it is at
+// least TRIM bytes, back to the kernel.
+static void
+trim(void)
 {
-  Header *bp, *p;
+  Header *p, *prevp;
+  char *top;
+
+  top = sbrk(0);
+  for(prevp = freep, p = freep->s.ptr; ; prevp = p, p = p->s.ptr){
+    if((char*)(p + p->s.size) == top && p->s.size*sizeof(Header) >= TRIM){
+      prevp->s.ptr = p->s.ptr;
+      freep = prevp;
+      sbrk(-(p->s.size*sizeof(Header)));
+      return;
+    }
+    if(p == freep)
+      return;
+  }
+}
+
+static void
+largefree(Header *bp)
+{
+  Header *p;
 
-  bp = (Header*)ap - 1;
   for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
     if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
       break;
@@ -43,6 +80,28 @@ free(void *ap)
   freep = p;
 }
 
+void
+free(void *ap)
+{
+  Header *bp;
+  int c;
+
+  if(ap == 0)
+    return;
+  bp = (Header*)ap - 1;
+  if(ISSMALL(bp->s.ptr)){
+    c = (uint)bp->s.ptr - 1;
+    bp->s.ptr = smallfree[c];
+    smallfree[c] = bp;
+    return;
+  }
+  largefree(bp);
+  // The block holding bp is now freep or the one after it.
+  if(freep->s.size*sizeof(Header) >= TRIM ||
+     freep->s.ptr->s.size*sizeof(Header) >= TRIM)
+    trim();
+}
+
 static Header*
 morecore(uint nu)
 {
@@ -56,35 +115,119 @@ morecore(uint nu)
     return 0;
   hp = (Header*)p;
   hp->s.size = nu;
-  free((void*)(hp + 1));
+  largefree(hp);
   return freep;
 }
 
-void*
-malloc(uint nbytes)
+// Unlike K&R, search from the lowest address, and split free
+// blocks from the front, keeping free memory towards the top
+// of the heap for trim().
+static void*
+largealloc(uint nbytes)
 {
-  Header *p, *prevp;
+  Header *p, *prevp, *rest;
   uint nunits;
 
   nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
-  if((prevp = freep) == 0){
-    base.s.ptr = freep = prevp = &base;
+  if(freep == 0){
+    base.s.ptr = freep = &base;
     base.s.size = 0;
   }
-  for(p = prevp->s.ptr; ; prevp = p, p = p->s.ptr){
-    if(p->s.size >= nunits){
-      if(p->s.size == nunits)
-        prevp->s.ptr = p->s.ptr;
-      else {
-        p->s.size -= nunits;
-        p += p->s.size;
-        p->s.size = nunits;
+  for(;;){
+    for(prevp = &base, p = base.s.ptr; p != &base; prevp = p, p = p->s.ptr){
+      if(p->s.size >= nunits){
+        if(p->s.size == nunits)
+          prevp->s.ptr = p->s.ptr;
+        else {
+          rest = p + nunits;
+          rest->s.size = p->s.size - nunits;
+          rest->s.ptr = p->s.ptr;
+          prevp->s.ptr = rest;
+          p->s.size = nunits;
+        }
+        freep = prevp;
+        p->s.ptr = 0;
+        return (void*)(p + 1);
       }
-      freep = prevp;
-      return (void*)(p + 1);
     }
-    if(p == freep)
-      if((p = morecore(nunits)) == 0)
-        return 0;
+    if(morecore(nunits) == 0)
+      return 0;
+  }
+}
+
+// Carve a slab from the large allocator into blocks of class c.
+static int
+refill(int c)
+{
+  char *slab;
+  Header *bp;
+  int i, n;
+
+  if((slab = largealloc(SLAB)) == 0)
+    return -1;
+  n = SLAB / CLASSSZ(c);
+  for(i = 0; i < n; i++){
+    bp = (Header*)(slab + i*CLASSSZ(c));
+    bp->s.ptr = smallfree[c];
+    smallfree[c] = bp;
   }
+  return 0;
+}
+
+void*
+malloc(uint nbytes)
+{
+  Header *bp;
+  int c;
+
+  for(c = 0; c < NCLASS; c++)
+    if(nbytes + sizeof(Header) <= CLASSSZ(c))
+      break;
+  if(c == NCLASS)
+    return largealloc(nbytes);
+  if(smallfree[c] == 0 && refill(c) < 0)
+    return 0;
+  bp = smallfree[c];
+  smallfree[c] = bp->s.ptr;
+  bp->s.ptr = SMALL(c);
+  return (void*)(bp + 1);
+}
+
+void*
+calloc(uint n, uint size)
+{
+  void *p;
+
+  if(size != 0 && n > 0xffffffff / size)
+    return 0;
+  if((p = malloc(n * size)) != 0)
+    memset(p, 0, n * size);
+  return p;
+}
+
+void*
+realloc(void *ap, uint nbytes)
+{
+  Header *bp;
+  uint have;
+  void *p;
+
+  if(ap == 0)
+    return malloc(nbytes);
+  if(nbytes == 0){
+    free(ap);
+    return 0;
+  }
+  bp = (Header*)ap - 1;
+  if(ISSMALL(bp->s.ptr))
+    have = CLASSSZ((uint)bp->s.ptr - 1) - sizeof(Header);
+  else
+    have = (bp->s.size - 1) * sizeof(Header);
+  if(nbytes <= have)
+    return ap;
+  if((p = malloc(nbytes)) == 0)
+    return 0;
+  memmove(p, ap, have);
+  free(ap);
+  return p;
 }
@@ -1,5 +1,8 @@
 struct stat;
 struct rtcdate;
+struct iovec;
+struct procinfo;
+struct timespec;
 
 // system calls
 int fork(void);
@@ -23,6 +26,19 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int splice(int, int, int);
+int readv(int, struct iovec*, int);
+int writev(int, struct iovec*, int);
+int lseek(int, int, int);
+int pread(int, void*, int, int);
+int pwrite(int, void*, int, int);
+int fdlimit(int);
+int ioctl(int, int, int);
+int irqaffinity(int, int);
+int trace(int);
+int getprocinfo(struct procinfo*, int);
+int clock_gettime(int, struct timespec*);
+int nanosleep(struct timespec*);
 
 // ulib.c
 int stat(char*, struct stat*);
@@ -36,4 +52,12 @@ uint strlen(char*);
 void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
+void* calloc(uint, uint);
+void* realloc(void*, uint);
 int atoi(const char*);
+void clock_read(struct timespec*);
+int fflush(int);
+void flushall(void);
+int fwrite(int, void*, int);
+int fputs(int, char*);
+int fputc(int, int);
@@ -7,6 +7,12 @@
 #include "syscall.h"
 #include "traps.h"
 #include "memlayout.h"
+#include "uio.h"
+#include "procinfo.h"
+#include "trace.h"
+#include "prof.h"
+#include "x86.h"
+#include "clock.h"
 
 char buf[8192];
 char name[3];
@@ -354,6 +360,502 @@ pipe1(void)
   printf(1, "pipe1 ok\n");
 }
 
+// move a file through a pipe and into another file with splice.
+void
+splicetest(void)
+{
+  int fds[2], fd, pid, i, n, tot;
+
+  printf(1, "splice test\n");
+
+  fd = open("splice0", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf(1, "splice create failed\n");
+    exit();
+  }
+  for(i = 0; i < 1000; i++)
+    buf[i] = i;
+  for(i = 0; i < 10; i++){
+    if(write(fd, buf, 1000) != 1000){
+      printf(1, "splice write failed\n");
+      exit();
+    }
+  }
+  close(fd);
+
+  if(pipe(fds) != 0){
+    printf(1, "pipe() failed\n");
+    exit();
+  }
+  pid = fork();
+  if(pid < 0){
+    printf(1, "fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    close(fds[0]);
+    fd = open("splice0", 0);
+    while((n = splice(fd, fds[1], 3000)) > 0)
+      ;
+    if(n < 0){
+      printf(1, "splice file to pipe failed\n");
+      exit();
+    }
+    exit();
+  }
+  close(fds[1]);
+  fd = open("splice1", O_CREATE|O_RDWR);
+  tot = 0;
+  while((n = splice(fds[0], fd, 10000)) > 0)
+    tot += n;
+  close(fds[0]);
+  close(fd);
+  wait();
+  if(n < 0 || tot != 10000){
+    printf(1, "splice pipe to file failed %d\n", tot);
+    exit();
+  }
+
+  fd = open("splice1", 0);
+  for(tot = 0; (n = read(fd, buf, 1000)) > 0; tot += n){
+    for(i = 0; i < n; i++){
+      if((buf[i] & 0xff) != ((tot + i) % 1000 & 0xff)){
+        printf(1, "splice wrong data\n");
+        exit();
+      }
+    }
+  }
+  close(fd);
+  unlink("splice0");
+  unlink("splice1");
+  printf(1, "splice ok\n");
+}
+
+// write a file from several buffers with writev and
+// read it back into differently sized ones with readv.
+void
+iovtest(void)
+{
+  struct iovec iov[3];
+  char a[5], b[20], *want;
+  int fd, i;
+
+  printf(1, "iov test\n");
+
+  fd = open("iov", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf(1, "iov create failed\n");
+    exit();
+  }
+  iov[0].base = "hello";
+  iov[0].len = 5;
+  iov[1].base = ", ";
+  iov[1].len = 2;
+  iov[2].base = "world";
+  iov[2].len = 5;
+  if(writev(fd, iov, 3) != 12){
+    printf(1, "writev failed\n");
+    exit();
+  }
+  close(fd);
+
+  fd = open("iov", 0);
+  iov[0].base = a;
+  iov[0].len = sizeof(a);
+  iov[1].base = b;
+  iov[1].len = sizeof(b);
+  if(readv(fd, iov, 2) != 12){
+    printf(1, "readv failed\n");
+    exit();
+  }
+  close(fd);
+  want = "hello, world";
+  for(i = 0; i < 12; i++){
+    if((i < 5 ? a[i] : b[i-5]) != want[i]){
+      printf(1, "readv wrong data\n");
+      exit();
+    }
+  }
+  iov[0].base = (char*)0xffffffff;
+  if(readv(0, iov, 1) >= 0){
+    printf(1, "readv accepted a bad buffer\n");
+    exit();
+  }
+  unlink("iov");
+  printf(1, "iov ok\n");
+}
+
+// lseek, and pread and pwrite at explicit offsets, which
+// leave the file offset alone even when the fd is shared.
+void
+preadtest(void)
+{
+  int fd, pid, i, n;
+  char c;
+
+  printf(1, "pread test\n");
+
+  fd = open("pread", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf(1, "pread create failed\n");
+    exit();
+  }
+  memset(buf, 'x', 1000);
+  if(write(fd, buf, 1000) != 1000){
+    printf(1, "pread write failed\n");
+    exit();
+  }
+  if(lseek(fd, 0, SEEK_CUR) != 1000 || lseek(fd, -10, SEEK_END) != 990 ||
+     lseek(fd, 1, SEEK_END) >= 0 || lseek(fd, 0, SEEK_SET) != 0){
+    printf(1, "lseek failed\n");
+    exit();
+  }
+
+  // Parent and child each fill in every other byte.
+  pid = fork();
+  if(pid < 0){
+    printf(1, "fork failed\n");
+    exit();
+  }
+  for(i = (pid == 0); i < 1000; i += 2){
+    c = pid == 0 ? 'c' : 'p';
+    if(pwrite(fd, &c, 1, i) != 1){
+      printf(1, "pwrite failed\n");
+      exit();
+    }
+  }
+  if(pid == 0)
+    exit();
+  wait();
+
+  if(lseek(fd, 0, SEEK_CUR) != 0){
+    printf(1, "pwrite moved the offset\n");
+    exit();
+  }
+  for(i = 0; i < 1000; i++){
+    if(pread(fd, &c, 1, i) != 1 || c != (i % 2 ? 'c' : 'p')){
+      printf(1, "pread wrong data at %d\n", i);
+      exit();
+    }
+  }
+  n = pread(fd, buf, 100, 950);
+  if(n != 50 || lseek(fd, 0, SEEK_CUR) != 0){
+    printf(1, "pread past end failed\n");
+    exit();
+  }
+
+  // Buffered output lands before the offset moves.
+  printf(fd, "ab");
+  if(lseek(fd, 0, SEEK_SET) != 0 || write(fd, "X", 1) != 1 ||
+     pread(fd, buf, 3, 0) != 3 || buf[0] != 'X' || buf[1] != 'b' || buf[2] != 'p'){
+    printf(1, "lseek after printf failed\n");
+    exit();
+  }
+  close(fd);
+  unlink("pread");
+  printf(1, "pread ok\n");
+}
+
+// printf buffers, but write and writev must not pass it.
+void
+printwritetest(void)
+{
+  struct iovec iov[2];
+  char *want;
+  int fd, n;
+
+  printf(1, "printwrite test\n");
+
+  fd = open("printwrite", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf(1, "printwrite create failed\n");
+    exit();
+  }
+  printf(fd, "1");
+  write(fd, "2", 1);
+  printf(fd, "%d", 3);
+  iov[0].base = "4";
+  iov[0].len = 1;
+  iov[1].base = "5";
+  iov[1].len = 1;
+  writev(fd, iov, 2);
+  printf(fd, "6");
+  close(fd);
+
+  want = "123456";
+  fd = open("printwrite", O_RDONLY);
+  n = read(fd, buf, sizeof(buf) - 1);
+  buf[n < 0 ? 0 : n] = 0;
+  if(strcmp(buf, want) != 0){
+    printf(1, "printwrite wrong order\n");
+    exit();
+  }
+  close(fd);
+  unlink("printwrite");
+  printf(1, "printwrite ok\n");
+}
+
+// more fds than the initial table holds, lowest-first
+// allocation, and fdlimit().
+void
+fdtest(void)
+{
+  int fds[100], i, fd, old;
+
+  printf(1, "fd test\n");
+
+  for(i = 0; i < 100; i++){
+    if((fds[i] = dup(1)) < 0 || (i > 0 && fds[i] != fds[i-1] + 1)){
+      printf(1, "dup %d failed\n", i);
+      exit();
+    }
+  }
+  close(fds[40]);
+  close(fds[10]);
+  if(dup(1) != fds[10] || dup(1) != fds[40]){
+    printf(1, "dup not lowest free fd\n");
+    exit();
+  }
+  if(fdlimit(10) >= 0){
+    printf(1, "fdlimit below open fd succeeded\n");
+    exit();
+  }
+  for(i = 0; i < 100; i++)
+    close(fds[i]);
+
+  old = fdlimit(fds[0] + 2);
+  if(old < 100 || dup(1) != fds[0] || dup(1) != fds[0] + 1 || dup(1) >= 0){
+    printf(1, "fdlimit failed\n");
+    exit();
+  }
+  close(fds[0]);
+  close(fds[0] + 1);
+  if(fdlimit(old) != fds[0] + 2){
+    printf(1, "fdlimit restore failed\n");
+    exit();
+  }
+  if((fd = dup(1)) != fds[0]){
+    printf(1, "dup after fdlimit failed\n");
+    exit();
+  }
+  close(fd);
+  printf(1, "fd ok\n");
+}
+
+// console modes through ioctl, which only devices take.
+void
+ioctltest(void)
+{
+  int fd, mode;
+
+  printf(1, "ioctl test\n");
+
+  fd = open("ioctl", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf(1, "ioctl create failed\n");
+    exit();
+  }
+  if(ioctl(fd, CONSGETMODE, 0) >= 0){
+    printf(1, "ioctl on a file succeeded\n");
+    exit();
+  }
+  close(fd);
+  unlink("ioctl");
+
+  if((mode = ioctl(1, CONSGETMODE, 0)) < 0 || ioctl(1, -1, 0) >= 0){
+    printf(1, "console ioctl failed\n");
+    exit();
+  }
+  if(ioctl(1, CONSSETMODE, mode|CONS_NOECHO) < 0 ||
+     ioctl(1, CONSGETMODE, 0) != (mode|CONS_NOECHO) ||
+     ioctl(1, CONSSETMODE, mode) < 0 || ioctl(1, CONSGETMODE, 0) != mode){
+    printf(1, "console mode failed\n");
+    exit();
+  }
+  printf(1, "ioctl ok\n");
+}
+
+// move the disk interrupt (IRQ 14) to CPU 0 and back,
+// with file system traffic in between.
+void
+irqtest(void)
+{
+  int old, fd;
+
+  printf(1, "irq test\n");
+
+  if(irqaffinity(99, 1) >= 0 || irqaffinity(14, 0) >= 0){
+    printf(1, "irqaffinity with bad args succeeded\n");
+    exit();
+  }
+  if((old = irqaffinity(14, 1)) <= 0){
+    printf(1, "irqaffinity failed\n");
+    exit();
+  }
+  fd = open("irq", O_CREATE|O_RDWR);
+  if(fd < 0 || write(fd, buf, 4096) != 4096){
+    printf(1, "irq write failed\n");
+    exit();
+  }
+  close(fd);
+  unlink("irq");
+  if(irqaffinity(14, old) != 1){
+    printf(1, "irqaffinity restore failed\n");
+    exit();
+  }
+  printf(1, "irq ok\n");
+}
+
+void
+tracetest(void)
+{
+  static struct tracerec rec[64];
+  struct tracerec one;
+  int fd, i, n, pid;
+
+  printf(1, "trace test\n");
+
+  if((fd = open("/dev/trace", O_RDWR)) < 0 || write(fd, "", 1) != 1){
+    printf(1, "cannot empty /dev/trace\n");
+    exit();
+  }
+  if(trace(1) != 0 || (pid = getpid()) <= 0 || trace(0) != 1){
+    printf(1, "trace failed\n");
+    exit();
+  }
+  // Offsets are absolute, and the ring was just emptied, so
+  // a read at 0 starts at the oldest record kept.
+  n = pread(fd, rec, sizeof(rec), 0);
+  if(n <= 0 || n % sizeof(rec[0]) != 0){
+    printf(1, "trace read %d bytes\n", n);
+    exit();
+  }
+  for(i = 0; i < n / sizeof(rec[0]); i++)
+    if(rec[i].num == SYS_getpid && rec[i].pid == pid && rec[i].ret == pid &&
+       rec[i].session == pid)
+      break;
+  if(i == n / sizeof(rec[0])){
+    printf(1, "getpid not traced\n");
+    exit();
+  }
+  if(pread(fd, &one, sizeof(one), rec[i].seq * sizeof(one)) != sizeof(one) ||
+     one.seq != rec[i].seq || one.num != SYS_getpid){
+    printf(1, "trace record not at its offset\n");
+    exit();
+  }
+  close(fd);
+  printf(1, "trace ok\n");
+}
+
+void
+proftest(void)
+{
+  static struct profrec rec[64];
+  int fd, i, n, pid;
+  uint t0;
+
+  printf(1, "prof test\n");
+
+  if((fd = open("/dev/prof", O_RDONLY)) < 0 || ioctl(fd, PROFSTART, 0) < 0){
+    printf(1, "cannot start /dev/prof\n");
+    exit();
+  }
+  if(ioctl(fd, PROFSTART, PROFMINPERIOD - 1) >= 0){
+    printf(1, "PROFSTART took a period below PROFMINPERIOD\n");
+    exit();
+  }
+  // Spin rather than sleep, so that ticks find this process running.
+  t0 = uptime();
+  while(uptime() - t0 < 5)
+    ;
+  if(ioctl(fd, PROFSTOP, 0) < 0){
+    printf(1, "PROFSTOP failed\n");
+    exit();
+  }
+  pid = getpid();
+  n = read(fd, rec, sizeof(rec));
+  close(fd);
+  if(n <= 0 || n % sizeof(rec[0]) != 0){
+    printf(1, "prof read %d bytes\n", n);
+    exit();
+  }
+  for(i = 0; i < n / sizeof(rec[0]); i++)
+    if(rec[i].pid == pid && strcmp(rec[i].name, "usertests") == 0)
+      break;
+  if(i == n / sizeof(rec[0])){
+    printf(1, "no samples of usertests\n");
+    exit();
+  }
+  printf(1, "prof ok\n");
+}
+
+void
+procinfotest(void)
+{
+  static struct procinfo pi[NPROC];
+  int i, n;
+
+  printf(1, "procinfo test\n");
+
+  if(getprocinfo(pi, -1) >= 0 || getprocinfo((struct procinfo*)0xffffff00, 4) >= 0){
+    printf(1, "getprocinfo with bad args succeeded\n");
+    exit();
+  }
+  n = getprocinfo(pi, NPROC);
+  for(i = 0; i < n; i++)
+    if(pi[i].pid == getpid())
+      break;
+  if(i == n || strcmp(pi[i].name, "usertests") != 0 || pi[i].rss == 0){
+    printf(1, "getprocinfo failed\n");
+    exit();
+  }
+  printf(1, "procinfo ok\n");
+}
+
+void
+clocktest(void)
+{
+  struct timespec t0, t1, t2, d;
+
+  printf(1, "clock test\n");
+
+  if(clock_gettime(0, &t0) >= 0 || clock_gettime(CLOCK_MONOTONIC, (struct timespec*)0xffffff00) >= 0){
+    printf(1, "clock_gettime with bad args succeeded\n");
+    exit();
+  }
+  d.sec = 0;
+  d.nsec = 1000000000;
+  if(nanosleep(&d) >= 0){
+    printf(1, "nanosleep with bad args succeeded\n");
+    exit();
+  }
+
+  // Sleep 20 ms, rounded up to a tick.
+  if(clock_gettime(CLOCK_MONOTONIC, &t0) < 0){
+    printf(1, "clock_gettime failed\n");
+    exit();
+  }
+  d.nsec = 20000000;
+  if(nanosleep(&d) < 0){
+    printf(1, "nanosleep failed\n");
+    exit();
+  }
+  clock_read(&t1);
+  if(clock_gettime(CLOCK_MONOTONIC, &t2) < 0){
+    printf(1, "clock_gettime failed\n");
+    exit();
+  }
+  if(t1.sec*(uint64)1000000000 + t1.nsec < t0.sec*(uint64)1000000000 + t0.nsec + d.nsec){
+    printf(1, "nanosleep returned early\n");
+    exit();
+  }
+  if(t2.sec < t1.sec || (t2.sec == t1.sec && t2.nsec < t1.nsec)){
+    printf(1, "clock went backwards\n");
+    exit();
+  }
+  printf(1, "clock ok\n");
+}
+
 // meant to be run w/ at most two CPUs
 void
 preempt(void)
@@ -512,6 +1014,82 @@ sharedfd(void)
   }
 }
 
+// several processes read the same file at the same time,
+// sharing its inode lock, while another rewrites it in place.
+void
+sharedread(void)
+{
+  int fd, pid, i, j, k, n, nchild, pass;
+  char buf[512], c;
+
+  printf(1, "sharedread test\n");
+
+  unlink("sharedread");
+  fd = open("sharedread", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf(1, "sharedread create failed\n");
+    exit();
+  }
+  for(i = 0; i < 20; i++){
+    memset(buf, 'a' + i, sizeof(buf));
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf(1, "sharedread write failed\n");
+      exit();
+    }
+  }
+  close(fd);
+
+  nchild = 5;
+  for(j = 0; j < nchild; j++){
+    pid = fork();
+    if(pid < 0){
+      printf(1, "fork failed\n");
+      exit();
+    }
+    if(pid != 0)
+      continue;
+    // Child 0 rewrites each block, switching between 'a'+i
+    // and 'A'+i on each pass; the others check that no read
+    // sees part of one version and part of the other.
+    for(pass = 0; pass < 10; pass++){
+      fd = open("sharedread", O_RDWR);
+      if(fd < 0){
+        printf(1, "sharedread open failed\n");
+        exit();
+      }
+      for(i = 0; i < 20; i++){
+        if(j == 0){
+          memset(buf, (pass % 2 ? 'a' : 'A') + i, sizeof(buf));
+          if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+            printf(1, "sharedread rewrite failed\n");
+            exit();
+          }
+          continue;
+        }
+        n = read(fd, buf, sizeof(buf));
+        c = buf[0];
+        if(n != sizeof(buf) || (c != 'a' + i && c != 'A' + i)){
+          printf(1, "sharedread wrong data\n");
+          exit();
+        }
+        for(k = 1; k < n; k++){
+          if(buf[k] != c){
+            printf(1, "sharedread torn read\n");
+            exit();
+          }
+        }
+      }
+      close(fd);
+    }
+    exit();
+  }
+  for(j = 0; j < nchild; j++)
+    wait();
+  unlink("sharedread");
+
+  printf(1, "sharedread ok\n");
+}
+
 // four processes write different files at the same
 // time, to test block allocation.
 void
@@ -1347,7 +1925,7 @@ iref(void)
 
   printf(1, "empty file name\n");
 
-  // the 50 is NINODE
+  // more than the original NINODE of 50
   for(i = 0; i < 50 + 1; i++){
     if(mkdir("irefd") != 0){
       printf(1, "mkdir irefd failed\n");
@@ -1762,6 +2340,7 @@ main(int argc, char *argv[])
   concreate();
   fourfiles();
   sharedfd();
+  sharedread();
 
   bigargtest();
   bigwrite();
@@ -1781,6 +2360,17 @@ main(int argc, char *argv[])
 
   mem();
   pipe1();
+  splicetest();
+  iovtest();
+  preadtest();
+  printwritetest();
+  fdtest();
+  ioctltest();
+  irqtest();
+  tracetest();
+  proftest();
+  procinfotest();
+  clocktest();
   preempt();
   exitwait();
 
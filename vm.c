@@ -16,17 +16,34 @@ void
 seginit(void)
 {
   struct cpu *c;
+  int apicid;
+
+  // mycpu() can't be used until %gs is set up below,
+  // so find this cpu by its APIC ID.
+  apicid = lapicid();
+  for(c = cpus; c < &cpus[ncpu]; c++)
+    if(c->apicid == apicid)
+      break;
+  if(c == &cpus[ncpu])
+    panic("seginit: unknown apicid");
 
   // Map "logical" addresses to virtual addresses using identity map.
   // Cannot share a CODE descriptor for both kernel and user
   // because it would have to have DPL_USR, but the CPU forbids
   // an interrupt from CPL=0 to DPL=3.
-  c = &cpus[cpuid()];
   c->gdt[SEG_KCODE] = SEG(STA_X|STA_R, 0, 0xffffffff, 0);
   c->gdt[SEG_KDATA] = SEG(STA_W, 0, 0xffffffff, 0);
   c->gdt[SEG_UCODE] = SEG(STA_X|STA_R, 0, 0xffffffff, DPL_USER);
   c->gdt[SEG_UDATA] = SEG(STA_W, 0, 0xffffffff, DPL_USER);
+
+  // Map cpu->proc and cpu->self -- these are private per cpu.
+  c->gdt[SEG_KCPU] = SEG(STA_W, &c->proc, 8, 0);
   lgdt(c->gdt, sizeof(c->gdt));
+
+  // Initialize cpu-local storage.
+  c->self = c;
+  c->proc = 0;
+  loadgs(SEG_KCPU << 3);
 }
 
 // Return the address of the PTE in page table pgdir
@@ -87,8 +104,10 @@ mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm)
 //
 // setupkvm() and exec() set up every page table like this:
 //
-//   0..KERNBASE: user memory (text+data+stack+heap), mapped to
+//   0..CLOCKPAGE: user memory (text+data+stack+heap), mapped to
 //                phys memory allocated by the kernel
+//   CLOCKPAGE..KERNBASE: the clock page, read-only to user code
+//                (see clock.h)
 //   KERNBASE..KERNBASE+EXTMEM: mapped to 0..EXTMEM (for I/O space)
 //   KERNBASE+EXTMEM..data: mapped to EXTMEM..V2P(data)
 //                for the kernel's instructions and r/o data
@@ -132,6 +151,10 @@ setupkvm(void)
       freevm(pgdir);
       return 0;
     }
+  if(mappages(pgdir, (void*)CLOCKPAGE, PGSIZE, V2P(clockpage), PTE_U) < 0){
+    freevm(pgdir);
+    return 0;
+  }
   return pgdir;
 }
 
@@ -172,6 +195,8 @@ switchuvm(struct proc *p)
   // forbids I/O instructions (e.g., inb and outb) from user space
   mycpu()->ts.iomb = (ushort) 0xFFFF;
   ltr(SEG_TSS << 3);
+  if(!nosysenter)
+    wrmsr(MSR_SYSENTER_ESP, (uint)p->kstack + KSTACKSIZE);
   lcr3(V2P(p->pgdir));  // switch to process's address space
   popcli();
 }
@@ -223,7 +248,7 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   char *mem;
   uint a;
 
-  if(newsz >= KERNBASE)
+  if(newsz > CLOCKPAGE)
     return 0;
   if(newsz < oldsz)
     return oldsz;
@@ -286,7 +311,7 @@ freevm(pde_t *pgdir)
 
   if(pgdir == 0)
     panic("freevm: no pgdir");
-  deallocuvm(pgdir, KERNBASE, 0);
+  deallocuvm(pgdir, CLOCKPAGE, 0);
   for(i = 0; i < NPDENTRIES; i++){
     if(pgdir[i] & PTE_P){
       char * v = P2V(PTE_ADDR(pgdir[i]));
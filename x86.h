@@ -117,6 +117,15 @@ sti(void)
   asm volatile("sti");
 }
 
+// Enable interrupts and halt until one arrives.  sti takes effect
+// only after the following instruction, so an interrupt that is
+// already pending wakes the hlt instead of being taken before it.
+static inline void
+stihlt(void)
+{
+  asm volatile("sti; hlt");
+}
+
 static inline uint
 xchg(volatile uint *addr, uint newval)
 {
@@ -130,6 +139,47 @@ xchg(volatile uint *addr, uint newval)
   return result;
 }
 
+// Atomically add incr to *addr and return the old value.
+static inline uint
+xadd(volatile uint *addr, uint incr)
+{
+  asm volatile("lock; xaddl %0, %1" :
+               "+r" (incr), "+m" (*addr) :
+               :
+               "memory", "cc");
+  return incr;
+}
+
+// Tell the processor we are in a spin-wait loop.
+static inline void
+pause(void)
+{
+  asm volatile("pause" : : : "memory");
+}
+
+// Read the time-stamp counter.
+static inline uint64
+rdtsc(void)
+{
+  uint64 val;
+  asm volatile("rdtsc" : "=A" (val));
+  return val;
+}
+
+static inline void
+wrmsr(uint msr, uint64 val)
+{
+  asm volatile("wrmsr" : : "c" (msr), "A" (val));
+}
+
+// Execute cpuid for leaf; r gets eax, ebx, ecx, edx.
+static inline void
+cpuinfo(uint leaf, uint *r)
+{
+  asm volatile("cpuid" : "=a" (r[0]), "=b" (r[1]), "=c" (r[2]), "=d" (r[3])
+               : "a" (leaf), "c" (0));
+}
+
 static inline uint
 rcr2(void)
 {